@@ -5,7 +5,10 @@
 #include <utility>
 #include <vector>
 #include "SimpleLogger.h"
+#include "SegmentEnergyCache.h"
 #include <memory>
+#include <cstdint>
+#include <cmath>
 
 struct battery_model_t {
     double cell_capacity;
@@ -31,6 +34,43 @@ struct best_speed_model_t {
 };
 
 
+/*!
+ * Energy consumption and time of flight along a path or its part
+ */
+struct energy_time_t {
+    double energy; // [J]
+    double time; // [s]
+
+    energy_time_t &operator+=(const energy_time_t &rhs) {
+        energy += rhs.energy;
+        time += rhs.time;
+        return *this;
+    }
+
+    energy_time_t operator+(const energy_time_t &rhs) const {
+        return {energy + rhs.energy, time + rhs.time};
+    }
+};
+
+
+/*!
+ * Non-owning structure-of-arrays view of several 2D paths stored one after another.
+ * The j-th point of the batch is (x[j * stride], y[j * stride]), path i consists of points [offsets[i], offsets[i + 1]).
+ * Interleaved coordinates (x0, y0, x1, y1, ...) are viewed with y = x + 1 and stride 2
+ */
+template<typename T>
+struct basic_path_batch_t {
+    const T *x;
+    const T *y;
+    size_t stride; // Distance between two consecutive coordinates in number of elements
+    const uint32_t *offsets; // n_paths + 1 values
+    size_t n_paths;
+};
+
+using path_batch_t = basic_path_batch_t<double>;
+using path_batch_f32_t = basic_path_batch_t<float>;
+
+
 struct turning_properties_t {
     double v_before;
     double a_before;
@@ -65,8 +105,29 @@ private:
     double P_r; // Power consumption during movement with the speed v_r
     double P_h; // Power consumption during hover
 
-    mutable double m_total_path_time = 0.0;
+    // Turning properties sampled uniformly on [0, TURNING_TABLE_MAX_ANGLE]. Shared between copies as it is never modified
+    std::shared_ptr<const std::vector<turning_properties_t>> m_turning_table;
+    double m_turning_table_inv_step;
 
+    // Optional memo of segment energies. Shared between copies of the calculator as they have the same parameters
+    std::shared_ptr<SegmentEnergyCache> m_segment_cache;
+
+    /*!
+     * Fill the table of turning properties. Should be called after v_r is calculated
+     */
+    void build_turning_table();
+
+    /*!
+     * Calculate energy and time of flight along points [begin, end) of the batch
+     */
+    template<typename T>
+    [[nodiscard]] energy_time_t
+    calculate_batch_path_energy(const basic_path_batch_t<T> &batch, size_t begin, size_t end) const;
+
+public:
+    static constexpr size_t TURNING_TABLE_SIZE = 4096;
+    // Turns closer than 1 degree to a straight line are considered as no turn at all, so the table ends there
+    static constexpr double TURNING_TABLE_MAX_ANGLE = M_PI - M_PI / 180;
 
     /*!
      * Calculate the energy spent on turning manuver including the deceleration and acceleration
@@ -76,7 +137,14 @@ private:
      */
     [[nodiscard]] turning_properties_t calculate_turning_properties(double angle) const;
 
-public:
+    /*!
+     * Get the properties of the turn by linear interpolation in the table precomputed at construction.
+     * Angles out of the table range are calculated by calculate_turning_properties
+     *
+     * @param angle Turning angle [rad]
+     * @return Properties of the turn by angle
+     */
+    [[nodiscard]] turning_properties_t get_turning_properties(double angle) const;
 
     /*!
      * Calculate the angle between segment (p1, p2) and segment (p2, p3) in radians
@@ -99,11 +167,11 @@ public:
      * @param a_out Acceleration (deceleration) at the end of the segment. Negative value always
      * @param p1 Start point of the path segment
      * @param p2 End point of the path segment
-     * @return Energy consumption in Joules
+     * @return Energy consumption in Joules and time of flight in seconds
      */
-    [[nodiscard]] double calculate_straight_line_energy(double v_in, double a_in, double v_out, double a_out,
-                                                        const std::pair<double, double> &p1,
-                                                        const std::pair<double, double> &p2) const;
+    [[nodiscard]] energy_time_t calculate_straight_line_energy(double v_in, double a_in, double v_out, double a_out,
+                                                               const std::pair<double, double> &p1,
+                                                               const std::pair<double, double> &p2) const;
 
     /*!
      * Calculate the energy of a UAV moving along a straight line
@@ -112,9 +180,9 @@ public:
      * @param v_out Output speed along the movement direction [m/s]
      * @param a_out Output acceleration (negative) along the movement direction m[s^2]
      * @param s length of the segment [m]
-     * @return Energy consumption in Joules
+     * @return Energy consumption in Joules and time of flight in seconds
      */
-    [[nodiscard]] double
+    [[nodiscard]] energy_time_t
     calculate_straight_line_energy(double v_in, double a_in, double v_out, double a_out, double s) const;
 
 
@@ -123,11 +191,11 @@ public:
      * @param turn1 Turn before the straight line segment
      * @param turn2 Turn after the straight line segment
      * @param s_tot Total distance between two turns
-     * @return Energy consumption in Joules
+     * @return Energy consumption in Joules and time of flight in seconds
      */
-    [[nodiscard]] double calculate_straight_line_energy_between_turns(const turning_properties_t &turn1,
-                                                                      const turning_properties_t &turn2,
-                                                                      double s_tot) const;
+    [[nodiscard]] energy_time_t calculate_straight_line_energy_between_turns(const turning_properties_t &turn1,
+                                                                             const turning_properties_t &turn2,
+                                                                             double s_tot) const;
 
     /*!
    * Get the energy spent on traversing a short lin, on which the optimal speed cannot be reached
@@ -136,9 +204,9 @@ public:
    * @param v_out Speed of the UAV wile leaving the segment
    * @param a_out Deceleration of UAV (negative value)
    * @param s Distance of the segment
-   * @return Amount of energy spent to accelerate, and drop speed back to v_out moving only s meters
+   * @return Amount of energy spent to accelerate, and drop speed back to v_out moving only s meters, and the time of it
    */
-    [[nodiscard]] double
+    [[nodiscard]] energy_time_t
     calculate_short_line_energy(double v_in, double a_in, double v_out, double a_out, double s) const;
 
     explicit EnergyCalculator(const energy_calculator_config_t &energy_calculator_config): EnergyCalculator(energy_calculator_config, std::make_shared<loggers::SimpleLogger>()) {};
@@ -157,6 +225,79 @@ public:
      */
     [[nodiscard]] double calculate_path_energy_consumption(const std::vector<std::pair<double, double>> &path) const;
 
+    /*!
+     * Calculate the total energy spent to follow the path and the time of flight along it
+     *
+     * @param path Path for which the total power consumption will be calculated
+     * @return Energy in Joules [J] and time in seconds [s]
+     */
+    [[nodiscard]] energy_time_t
+    calculate_path_energy_and_time(const std::vector<std::pair<double, double>> &path) const;
+
+    /*!
+     * Calculate the energy and time of flight for each path of the batch.
+     * Works in fixed-size blocks on the stack, so no memory is allocated
+     *
+     * @param batch View of the paths in the metric coordinates
+     * @param out Array of at least batch.n_paths elements to be filled with the result for each path
+     */
+    void calculate_path_energy_batch(const path_batch_t &batch, energy_time_t *out) const;
+
+    /*!
+     * The same as calculate_path_energy_batch() for paths with single precision coordinates
+     */
+    void calculate_path_energy_batch(const path_batch_f32_t &batch, energy_time_t *out) const;
+
+    /*!
+     * Calculate the energy and time of a path given by its geometry only. Uses the segment energy cache if it is set
+     *
+     * @param lengths Lengths of n_segments path segments [m]. There should be no segments of zero length
+     * @param angles Turn angles at the segment starts [rad]. angles[0] is not used as the path starts from hovering
+     * @param n_segments Number of the path segments
+     * @return Energy in Joules [J] and time in seconds [s]
+     */
+    [[nodiscard]] energy_time_t
+    calculate_path_energy_from_geometry(const double *lengths, const double *angles, size_t n_segments) const;
+
+    /*!
+     * Get the turn at an inner point of a path in the same way as the path energy functions do. If the segment
+     * cache is set, the angle is quantised first
+     *
+     * @param angle Turning angle [rad]
+     * @param key Set to the segment cache key of the turn if the cache is set
+     * @return Properties of the turn by angle
+     */
+    [[nodiscard]] turning_properties_t get_path_turn(double angle, uint32_t &key) const;
+
+    /*!
+     * Get the energy of a straight path segment between two turns in the same way as the path energy functions do,
+     * taking it from the segment cache if it is set
+     *
+     * @param turn1 Turn before the segment
+     * @param turn1_key Cache key of turn1: from get_path_turn(), SegmentEnergyCache::START_TURN_KEY or STOP_TURN_KEY
+     * @param turn2 Turn after the segment
+     * @param turn2_key Cache key of turn2
+     * @param length Length of the segment [m]
+     * @return Energy consumption in Joules and time of flight in seconds
+     */
+    [[nodiscard]] energy_time_t get_path_segment_energy(const turning_properties_t &turn1, uint32_t turn1_key,
+                                                        const turning_properties_t &turn2, uint32_t turn2_key,
+                                                        double length) const;
+
+    /*!
+     * @return Properties of the "turn" at the first point of a path, where the UAV starts from hovering
+     */
+    [[nodiscard]] turning_properties_t get_start_turn() const {
+        return {0, 0, 0, config.average_acceleration, config.drone_mass * v_r * v_r / 2, 0.0};
+    }
+
+    /*!
+     * @return Properties of the "turn" at the last point of a path, where the UAV stops
+     */
+    [[nodiscard]] turning_properties_t get_stop_turn() const {
+        return {0, -config.average_acceleration, 0, 0, config.drone_mass * v_r * v_r / 2, 0.0};
+    }
+
     /*!
      * @return average acceleration from the config
      */
@@ -180,23 +321,20 @@ public:
     [[nodiscard]] double calculate_acceleration_energy(double v_in, double v_out, double time) const;
 
 
-    void set_logger(std::shared_ptr<loggers::SimpleLogger> new_logger) {
-        m_logger = std::move(new_logger);
-    }
-
-    // -----------------------------------------------------------
-    // Set of functions for path time calculation
-
     /*!
-     * Reset the internal counter for path times
+     * Memoise the energies of path segments in calculate_path_energy_batch() and functions using it.
+     * Turn angles and segment lengths are then quantised to SegmentEnergyCache::ANGLE_QUANTUM and
+     * SegmentEnergyCache::LENGTH_QUANTUM, so the results may differ slightly from ones without the cache.
+     * Should be called before the calculator is shared between threads
+     * @param n_entries Maximum number of memoised segments. 0 disables the memo
      */
-    void reset_path_time() { m_total_path_time = 0; };
+    void enable_segment_cache(size_t n_entries) {
+        m_segment_cache = n_entries == 0 ? nullptr : std::make_shared<SegmentEnergyCache>(n_entries);
+    }
 
-    /*!
-     * Get the travel time of all calculated paths after the constructor or reset_path_time() calls
-     * @return total time in seconds
-     */
-    [[nodiscard]] double get_total_path_time() const { return m_total_path_time; };
+    void set_logger(std::shared_ptr<loggers::SimpleLogger> new_logger) {
+        m_logger = std::move(new_logger);
+    }
 
     /*!
      * @return Power consumption on hover in Watts
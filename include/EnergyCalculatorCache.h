@@ -0,0 +1,61 @@
+#ifndef THESIS_TRAJECTORY_GENERATOR_ENERGYCALCULATORCACHE_H
+#define THESIS_TRAJECTORY_GENERATOR_ENERGYCALCULATORCACHE_H
+
+#include "EnergyCalculator.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*!
+ * Small least-recently-used cache of energy calculators keyed by their configuration, so that the derived constants,
+ * the turning table and the segment memo are not built again for every request with the same UAV parameters
+ */
+class EnergyCalculatorCache {
+public:
+    /*!
+     * @param capacity Maximum number of stored calculators
+     * @param logger Logger for the created calculators
+     * @param segment_cache_size Size of the segment energy memo of each created calculator. 0 to disable it
+     */
+    EnergyCalculatorCache(size_t capacity, std::shared_ptr<loggers::SimpleLogger> logger, size_t segment_cache_size);
+
+    /*!
+     * Get the calculator for the configuration, creating it if it is not cached yet
+     * @param config Effective configuration of the UAV
+     * @return Calculator that can be used from several threads
+     */
+    std::shared_ptr<const EnergyCalculator> get(const energy_calculator_config_t &config);
+
+    /*!
+     * Get the cached calculator for the configuration without reordering the cache, or create a new one with the
+     * same settings that is not stored. For one-off configurations (e.g. what-if sweeps over many UAV variants) that
+     * should not evict the calculators in use
+     * @param config Effective configuration of the UAV
+     * @return Calculator that can be used from several threads
+     */
+    std::shared_ptr<const EnergyCalculator> get_uncached(const energy_calculator_config_t &config);
+
+    /*!
+     * Hash of all the fields of the configuration
+     */
+    [[nodiscard]] static size_t config_hash(const energy_calculator_config_t &config);
+
+private:
+    [[nodiscard]] std::shared_ptr<EnergyCalculator> create(const energy_calculator_config_t &config) const;
+
+    struct entry_t {
+        size_t hash;
+        energy_calculator_config_t config;
+        std::shared_ptr<const EnergyCalculator> calculator;
+    };
+
+    size_t m_capacity;
+    std::shared_ptr<loggers::SimpleLogger> m_logger;
+    size_t m_segment_cache_size;
+
+    std::mutex m_mutex;
+    // The most recently used entries are at the front
+    std::vector<entry_t> m_entries;
+};
+
+#endif //THESIS_TRAJECTORY_GENERATOR_ENERGYCALCULATORCACHE_H
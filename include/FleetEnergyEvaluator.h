@@ -0,0 +1,33 @@
+#ifndef THESIS_TRAJECTORY_GENERATOR_FLEETENERGYEVALUATOR_H
+#define THESIS_TRAJECTORY_GENERATOR_FLEETENERGYEVALUATOR_H
+
+#include "EnergyCalculator.h"
+#include <vector>
+#include <memory>
+
+/*!
+ * Evaluation of the same paths for several UAV configurations (e.g. while choosing the UAVs for a fleet).
+ * Filtering of the paths, segment lengths and turn angles do not depend on the UAV, so they are calculated once per
+ * path and shared by all the configurations
+ */
+class FleetEnergyEvaluator {
+public:
+    /*!
+     * @param calculators Calculator of each configuration, e.g. from EnergyCalculatorCache
+     */
+    explicit FleetEnergyEvaluator(std::vector<std::shared_ptr<const EnergyCalculator>> calculators);
+
+    /*!
+     * Calculate the energy and time of each path for each configuration
+     * @param batch View of the paths in the metric coordinates
+     * @return Results for configuration c and path p at index c * batch.n_paths + p
+     */
+    [[nodiscard]] std::vector<energy_time_t> evaluate(const path_batch_t &batch) const;
+
+    [[nodiscard]] size_t n_configs() const { return m_calculators.size(); }
+
+private:
+    std::vector<std::shared_ptr<const EnergyCalculator>> m_calculators;
+};
+
+#endif //THESIS_TRAJECTORY_GENERATOR_FLEETENERGYEVALUATOR_H
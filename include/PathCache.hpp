@@ -0,0 +1,79 @@
+#ifndef THESIS_TRAJECTORY_GENERATOR_PATHCACHE_HPP
+#define THESIS_TRAJECTORY_GENERATOR_PATHCACHE_HPP
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "custom_types.hpp"
+
+/*!
+ * Bounded cache of the shortest paths between pairs of points that can be used from several threads.
+ * The paths are undirected: a path from b to a is found as the reversed path from a to b.
+ * The cache is split into shards with their own locks, and each shard evicts entries by the CLOCK policy
+ */
+class PathCache {
+public:
+    /*!
+     * @param capacity Maximum number of stored paths. 0 to disable the cache
+     * @param quantum Grid size for rounding the point coordinates in keys. Points closer than that may share
+     * an entry. 0 to compare coordinates exactly
+     */
+    explicit PathCache(size_t capacity, double quantum = 0);
+
+    /*!
+     * Find the path between two points
+     * @param from Start of the path
+     * @param to End of the path
+     * @return Path starting in from and ending in to if it was cached
+     */
+    [[nodiscard]] std::optional<std::vector<point_t>> find(point_t from, point_t to) const;
+
+    /*!
+     * Store the path between two points, replacing the least recently used one if the shard is full
+     * @param path Path from path.front() to path.back()
+     */
+    void insert(const std::vector<point_t> &path);
+
+private:
+    static constexpr size_t N_SHARDS = 16;
+
+    struct key_t {
+        std::array<int64_t, 4> coordinates;
+
+        bool operator==(const key_t &other) const { return coordinates == other.coordinates; }
+    };
+
+    struct key_hash_t {
+        size_t operator()(const key_t &key) const;
+    };
+
+    struct entry_t {
+        key_t key;
+        std::vector<point_t> path;
+        bool referenced;
+    };
+
+    struct shard_t {
+        std::mutex mutex;
+        std::unordered_map<key_t, size_t, key_hash_t> index;
+        std::vector<entry_t> entries;
+        size_t clock_hand = 0;
+    };
+
+    size_t m_shard_capacity;
+    double m_quantum;
+    mutable std::array<shard_t, N_SHARDS> m_shards;
+
+    /*!
+     * Make the key of the unordered pair of points
+     * @param reversed Set to true if the points were swapped to make the key
+     */
+    [[nodiscard]] key_t make_key(point_t from, point_t to, bool &reversed) const;
+
+    [[nodiscard]] std::pair<int64_t, int64_t> quantize(point_t p) const;
+};
+
+#endif //THESIS_TRAJECTORY_GENERATOR_PATHCACHE_HPP
@@ -0,0 +1,69 @@
+#ifndef THESIS_TRAJECTORY_GENERATOR_PATHENERGYACCUMULATOR_H
+#define THESIS_TRAJECTORY_GENERATOR_PATHENERGYACCUMULATOR_H
+
+#include "EnergyCalculator.h"
+#include "custom_types.hpp"
+#include <vector>
+
+/*!
+ * Energy and time of a path that is built point by point.
+ * The result after each push_back() is the same as calculate_path_energy_and_time() of all the points pushed so far,
+ * but is obtained in O(1) as only the last segment depends on the new point. The segments are evaluated through the
+ * segment cache of the calculator in the same way as in calculate_path_energy_and_time()
+ */
+class PathEnergyAccumulator {
+public:
+    explicit PathEnergyAccumulator(EnergyCalculator energy_calculator);
+
+    /*!
+     * Append a point to the end of the path
+     * @param point Point in metric coordinates
+     */
+    void push_back(point_t point);
+
+    /*!
+     * Remove the last pushed point. Does nothing if the path is empty
+     */
+    void pop_back();
+
+    /*!
+     * Remove all the points
+     */
+    void clear() { m_states.clear(); }
+
+    /*!
+     * @return Number of pushed points (including repeated ones)
+     */
+    [[nodiscard]] size_t size() const { return m_states.size(); }
+
+    [[nodiscard]] bool empty() const { return m_states.empty(); }
+
+    /*!
+     * @return Energy [J] and time [s] of the path consisting of all the pushed points
+     */
+    [[nodiscard]] energy_time_t energy_and_time() const;
+
+    [[nodiscard]] double energy() const { return energy_and_time().energy; }
+
+    [[nodiscard]] double time() const { return energy_and_time().time; }
+
+private:
+    /*!
+     * State of the accumulator after one push_back(). Only the last segment ends with the stop turn, so the
+     * segments before it are summed up in committed, and the last one is only added to total
+     */
+    struct state_t {
+        point_t last_point;
+        point_t previous_point; // Point before last_point (after filtering out the repeated ones)
+        turning_properties_t previous_turn; // Turn at previous_point
+        uint32_t previous_turn_key; // Segment cache key of previous_turn
+        energy_time_t committed; // All the segments up to previous_point
+        energy_time_t total; // committed + the last segment
+        size_t n_points; // Number of different consecutive points
+    };
+
+    EnergyCalculator m_energy_calculator;
+    std::vector<state_t> m_states;
+};
+
+#endif //THESIS_TRAJECTORY_GENERATOR_PATHENERGYACCUMULATOR_H
@@ -0,0 +1,64 @@
+#ifndef THESIS_TRAJECTORY_GENERATOR_PATHENERGYINDEX_H
+#define THESIS_TRAJECTORY_GENERATOR_PATHENERGYINDEX_H
+
+#include "EnergyCalculator.h"
+#include "custom_types.hpp"
+#include <vector>
+
+/*!
+ * Prefix sums of energy and time along one path for queries on its sub-paths.
+ * A sub-path is flown as a separate path: the UAV starts from hovering at its first point and stops at its last one,
+ * so the first and the last segments are taken from separately stored boundary terms
+ */
+class PathEnergyIndex {
+public:
+    /*!
+     * Build the index in one pass over the path
+     * @param energy_calculator Calculator with the UAV parameters
+     * @param path Path in metric coordinates
+     */
+    PathEnergyIndex(const EnergyCalculator &energy_calculator, const std::vector<point_t> &path);
+
+    /*!
+     * Energy and time of the sub-path in O(1)
+     * @param from Index of the first point of the sub-path in the original path
+     * @param to Index of the last point of the sub-path in the original path
+     * @return Energy [J] and time [s] needed to fly from point from to point to along the path
+     */
+    [[nodiscard]] energy_time_t range(size_t from, size_t to) const;
+
+    /*!
+     * Find the first point at which the sub-path starting at from exceeds the energy limit in O(log n).
+     * Relies on the energy of a sub-path growing with the number of its points
+     * @param from Index of the first point of the sub-path in the original path
+     * @param energy_limit Energy limit [J]
+     * @return Index of the first point in the original path such that range(from, index).energy > energy_limit, or
+     * size() if the whole rest of the path fits into the limit
+     */
+    [[nodiscard]] size_t find_energy_limit(size_t from, double energy_limit) const;
+
+    /*!
+     * @return Number of points in the original path
+     */
+    [[nodiscard]] size_t size() const { return m_filtered_index.size(); }
+
+private:
+    [[nodiscard]] energy_time_t filtered_range(size_t from, size_t to) const;
+
+    // Index of the corresponding point after removing repeated consecutive points, for each original point
+    std::vector<size_t> m_filtered_index;
+    // Index of the first original point for each filtered one
+    std::vector<size_t> m_original_index;
+
+    // Sum of segments (turn at their start + straight line) from the first inner point up to point k, not including
+    // the first and the last segments of any sub-path
+    std::vector<energy_time_t> m_inner_prefix;
+    // Segment k if it is the first one of a sub-path: starting from hover and turning at point k + 1
+    std::vector<energy_time_t> m_start_segment;
+    // Segment k if it is the last one of a sub-path: turning at point k and stopping at point k + 1
+    std::vector<energy_time_t> m_end_segment;
+    // Segment k if it is the only one of a sub-path
+    std::vector<energy_time_t> m_single_segment;
+};
+
+#endif //THESIS_TRAJECTORY_GENERATOR_PATHENERGYINDEX_H
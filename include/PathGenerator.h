@@ -23,12 +23,20 @@
 #include <mrs_msgs/PathSrv.h>
 #include <std_msgs/String.h>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include "EnergyCalculator.h"
+#include "EnergyCalculatorCache.h"
+#include "ThreadPool.h"
+#include "ShortestPathStore.hpp"
 #include <thesis_path_generator/GeneratePaths.h>
 #include "utils.hpp"
 #include "mstsp_solver/MstspSolver.h"
 #include "SimpleLogger.h"
 #include <thesis_path_generator/CalculateEnergy.h>
+#include <thesis_path_generator/CalculateFleetEnergy.h>
+#include <thesis_path_generator/CalculateEnergyCompact.h>
 
 namespace path_generation {
 
@@ -46,14 +54,34 @@ namespace path_generation {
         bool m_is_initialized = false;
 
         /* ros parameters */
-        double m_drones_altitude;
-        double m_unique_altitude_step;
         energy_calculator_config_t m_energy_config;
 
 
         /* other parameters */
         int sequence_counter = 0;
         int m_number_of_rotations;
+        int m_replan_no_improvement_cycles;
+        int m_segment_energy_cache_size; // Number of memoised path segment energies per calculator. 0 to disable
+
+        int m_worker_threads; // Threads for parallel evaluation of service requests. 0 for the number of cores
+        std::unique_ptr<ThreadPool> m_thread_pool;
+
+        // Calculators for the recently requested UAV parameters
+        static constexpr size_t ENERGY_CALCULATOR_CACHE_SIZE = 8;
+        std::unique_ptr<EnergyCalculatorCache> m_energy_calculators;
+
+        std::string m_shortest_paths_directory; // Directory for the precomputed shortest paths. Empty to disable
+        bool m_warm_up_shortest_paths; // Read the stored shortest paths into the page cache at startup
+        std::unique_ptr<ShortestPathStore> m_shortest_path_store;
+
+        // | ------------------ re-planning cache ------------------ |
+
+        // The last solved field. If the next request differs only in the starting point or altitudes,
+        // the solver with its decomposition and targets is reused
+        std::mutex m_replan_cache_mutex;
+        std::optional<thesis_path_generator::GeneratePaths::Request> m_cached_request;
+        std::shared_ptr<mstsp_solver::MstspSolver> m_cached_solver;
+        mstsp_solver::_instance_solution_t m_cached_solution;
 
 
         // | --------------------- MRS transformer -------------------- |
@@ -61,6 +89,8 @@ namespace path_generation {
         // | ---------------------- msg callbacks --------------------- |
 
         ros::ServiceServer m_calculate_energy_service_server;
+        ros::ServiceServer m_calculate_energy_compact_service_server;
+        ros::ServiceServer m_calculate_fleet_energy_service_server;
         ros::ServiceServer m_generate_paths_service_server;
         ros::Publisher m_path_publisher;
 
@@ -73,6 +103,25 @@ namespace path_generation {
         bool callback_calculate_energy(thesis_path_generator::CalculateEnergy::Request &req,
                                        thesis_path_generator::CalculateEnergy::Response &res);
 
+        /*!
+         * Callback function for ROS service for paths energy calculation with paths as flat coordinate arrays.
+         * Metric coordinates are read directly from the request without copying
+         * @param req Service request. Contains drone parameters, coordinates of all the paths and their offsets
+         * @param res Result message. if calculation is successful contains array of energies for each path
+         * @return false of node is not initialized still
+         */
+        bool callback_calculate_energy_compact(thesis_path_generator::CalculateEnergyCompact::Request &req,
+                                               thesis_path_generator::CalculateEnergyCompact::Response &res);
+
+        /*!
+         * Callback function for ROS service for paths energy calculation with several variants of UAV parameters
+         * @param req Service request. Contains paths and UAV parameter variants
+         * @param res Result message. If calculation is successful contains energies and times for each variant and path
+         * @return false of node is not initialized still
+         */
+        bool callback_calculate_fleet_energy(thesis_path_generator::CalculateFleetEnergy::Request &req,
+                                             thesis_path_generator::CalculateFleetEnergy::Response &res);
+
         bool callback_generate_paths(thesis_path_generator::GeneratePaths::Request &req,
                                      thesis_path_generator::GeneratePaths::Response &res);
 
@@ -82,7 +131,19 @@ namespace path_generation {
                        MapPolygon polygon,
                        const EnergyCalculator &energy_calculator,
                        const ShortestPathCalculator &shortest_path_calculator,
-                       std::pair<double, double> gps_transform_origin);
+                       std::pair<double, double> gps_transform_origin,
+                       std::shared_ptr<mstsp_solver::MstspSolver> &best_solver);
+
+        /*!
+         * Re-plan the last solved field if the request differs from the cached one only in the starting point or altitudes
+         * @param req Service request
+         * @param gps_transform_origin Origin of the transformation from GPS coordinates to meters
+         * @param solution Output solution. Set only if true is returned
+         * @return true if the solution was obtained by re-planning, false if the full solution is needed
+         */
+        bool replan_cached(const thesis_path_generator::GeneratePaths::Request &req,
+                           std::pair<double, double> gps_transform_origin,
+                           mstsp_solver::final_solution_t &solution);
 
 
         /*!
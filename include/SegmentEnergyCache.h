@@ -0,0 +1,63 @@
+#ifndef THESIS_TRAJECTORY_GENERATOR_SEGMENTENERGYCACHE_H
+#define THESIS_TRAJECTORY_GENERATOR_SEGMENTENERGYCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+/*!
+ * Bounded memo of straight segment energies between two turns, keyed on the quantised turn angles and the segment
+ * length in millimeters. The table is direct-mapped: a new entry overwrites the one with the same hash slot.
+ * Each entry is guarded by a sequence counter (seqlock), so lookups never block and concurrent insertions into the
+ * same slot are skipped instead of waited for
+ */
+class SegmentEnergyCache {
+public:
+    // Keys of the turns at the path start and end that are not defined by any angle
+    static constexpr uint32_t START_TURN_KEY = UINT32_MAX;
+    static constexpr uint32_t STOP_TURN_KEY = UINT32_MAX - 1;
+    static constexpr double ANGLE_QUANTUM = 1e-5; // [rad]
+    static constexpr double LENGTH_QUANTUM = 1e-3; // [m]
+
+    /*!
+     * @param n_entries Maximum number of stored segments. Rounded up to a power of 2
+     */
+    explicit SegmentEnergyCache(size_t n_entries);
+
+    [[nodiscard]] static uint32_t angle_key(double angle);
+
+    [[nodiscard]] static uint64_t length_key(double length);
+
+    /*!
+     * Find the segment in the cache
+     * @param turn1 Key of the turn at the segment start
+     * @param turn2 Key of the turn at the segment end
+     * @param length Key of the segment length
+     * @param energy Energy [J] of the segment, set only if it was found
+     * @param time Time [s] of the segment, set only if it was found
+     * @return true if the segment was found
+     */
+    bool find(uint32_t turn1, uint32_t turn2, uint64_t length, double &energy, double &time) const;
+
+    /*!
+     * Store the segment, replacing the one in the same slot. Does nothing if another thread is writing the slot now
+     */
+    void insert(uint32_t turn1, uint32_t turn2, uint64_t length, double energy, double time);
+
+private:
+    struct entry_t {
+        // Even when the entry is stable, odd while it is being written. 0 for an empty entry
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<uint64_t> turns{0};
+        std::atomic<uint64_t> length{0};
+        std::atomic<uint64_t> energy_bits{0};
+        std::atomic<uint64_t> time_bits{0};
+    };
+
+    [[nodiscard]] size_t slot(uint64_t turns, uint64_t length) const;
+
+    std::unique_ptr<entry_t[]> m_entries;
+    size_t m_mask;
+};
+
+#endif //THESIS_TRAJECTORY_GENERATOR_SEGMENTENERGYCACHE_H
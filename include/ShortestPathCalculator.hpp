@@ -1,23 +1,23 @@
 #ifndef THESIS_TRAJECTORY_GENERATOR_SHORTESTPATHCALCULATOR_HPP
 #define THESIS_TRAJECTORY_GENERATOR_SHORTESTPATHCALCULATOR_HPP
 
+#include <cstdint>
+#include <limits>
 #include <map>
 #include <vector>
+#include <memory>
 #include "MapPolygon.hpp"
-#include <unordered_map>
+#include "PathCache.hpp"
+#include "SpatialIndex.hpp"
+
+class ThreadPool;
 
 struct shortest_path_calculation_error: public std::runtime_error {
     using runtime_error::runtime_error;
 };
 
-/*!
- * Struct to make hashing of pair of points possible
- */
-struct point_pair_hash {
-    size_t operator()(const std::pair<point_t, point_t> &p) const {
-        auto hash = std::hash<double>{};
-        return hash(p.first.first) + hash(p.first.second) + hash(p.second.first) + hash(p.second.second);
-    };
+struct shortest_paths_file_error: public std::runtime_error {
+    using runtime_error::runtime_error;
 };
 
 /*!
@@ -25,18 +25,117 @@ struct point_pair_hash {
  */
 class ShortestPathCalculator {
 private:
+    // The polygon the calculator was built for and the no-fly zones added to it later by their identifiers
+    MapPolygon m_polygon;
+    std::map<size_t, polygon_t> m_obstacles;
+    size_t m_next_obstacle_id = 0;
+
     std::vector<segment_t> m_polygon_segments;
-    mutable std::map<point_t, int> m_point_index;
+    std::map<point_t, int> m_point_index;
+    // Reflex polygon vertices, the only ones at which the shortest paths can bend. Nodes of the visibility graph
     std::vector<point_t> m_polygon_points;
-    std::vector<std::vector<double>> m_floyd_warshall_d;
-    std::vector<std::vector<size_t>> m_next_vertex_in_path;
-    mutable std::unordered_map<std::pair<point_t, point_t>, std::vector<std::pair<double, double>>, point_pair_hash> paths_cache;
+    // Row-major matrices of size m_polygon_points.size() ^ 2. Empty if the paths are searched on demand
+    std::vector<double> m_floyd_warshall_d;
+    std::vector<uint32_t> m_next_vertex_in_path;
+    // Visibility graph as adjacency lists of (vertex, edge length). Used to search the paths on demand and to update
+    // the paths when no-fly zones change
+    std::vector<std::vector<std::pair<uint32_t, double>>> m_visibility_graph;
+    bool m_lazy_shortest_paths = false;
+    // Shared by the copies of the calculator, as they are built for the same polygon
+    std::shared_ptr<PathCache> m_paths_cache;
+    // Points registered for repeated queries, the graph vertices each of them sees and their mutual visibility as
+    // a row-major bit matrix with rows padded to whole words
+    std::map<point_t, size_t> m_query_point_index;
+    std::vector<std::vector<std::pair<size_t, double>>> m_query_point_seen_vertices;
+    std::vector<uint64_t> m_query_points_visibility;
+    size_t m_query_points_visibility_row_words = 0;
+
+    // Spatial indices for visibility and the closest vertex queries
+    SegmentGrid m_segment_grid;
+    PointKdTree m_point_tree;
+
+    static constexpr uint32_t NO_VERTEX = std::numeric_limits<uint32_t>::max();
+    static constexpr size_t NO_QUERY_POINT = std::numeric_limits<size_t>::max();
+    // Maximum number of cached paths between points
+    static constexpr size_t PATHS_CACHE_CAPACITY = 1 << 16;
+    // Points closer than that [m] share the cached paths. Only merges the coordinates differing by rounding errors
+    static constexpr double PATHS_CACHE_QUANTUM = 1e-6;
+
+    /*!
+     * Find the polygon segments and the graph vertices of m_polygon and build the spatial indices over them
+     */
+    void init_polygon();
+
+    /*!
+     * @return The polygon with all the added no-fly zones
+     */
+    MapPolygon current_polygon() const;
+
+    /*!
+     * Check that following the next vertices from any vertex reaches every target it has a path to, without cycles.
+     * Used to validate the matrices loaded from a file
+     */
+    bool next_vertices_reach_targets() const;
 
     /*!
      * Run the Floyd-Warshall on initial matrix to calculate shortest paths between all
+     * @param thread_pool Pool to relax independent tiles of the matrix on. nullptr to run in the calling thread
+     */
+    void run_floyd_warshall(ThreadPool *thread_pool);
+
+
+    /*!
+     * Update the visibility graph and the shortest paths after a no-fly zone was added or removed.
+     * Only the pairs of vertices, the segment between which crosses the changed area, are checked again. Only the
+     * rows of the shortest paths matrix that used a removed edge or can be improved by an added one are recalculated
+     * @param box Bounding box of the changed no-fly zone as (min point, max point)
+     * @param removed true if the no-fly zone was removed, false if it was added
+     * @param thread_pool Pool to run the update on. nullptr to run in the calling thread
+     */
+    void update_obstacles(std::pair<point_t, point_t> box, bool removed, ThreadPool *thread_pool);
+
+    /*!
+     * Find the shortest paths from a vertex to all the others with Dijkstra in the visibility graph
+     * @param d Row of the path lengths to fill
+     * @param next Row of the next vertices in the paths to fill
+     */
+    void shortest_paths_from_vertex(size_t source, double *d, uint32_t *next) const;
+
+    /*!
+     * Find the graph vertices that can be reached from the point in a straight line
+     * @return Pairs of (vertex index, distance from the point to it)
+     */
+    std::vector<std::pair<size_t, double>> seen_vertices(point_t p) const;
+
+    /*!
+     * Find the index of a registered query point
+     * @return Index of the point or NO_QUERY_POINT if it was not registered
+     */
+    size_t query_point_index(point_t p) const;
+
+    /*!
+     * Same as point_can_see_point, but looks the visibility up if both points are registered query points
+     * @param q1 Query point index of p1 or NO_QUERY_POINT
+     * @param q2 Query point index of p2 or NO_QUERY_POINT
      */
-    void run_floyd_warshall();
+    bool point_can_see_point(point_t p1, size_t q1, point_t p2, size_t q2) const;
 
+    /*!
+     * Find the lengths of the shortest paths from any of the sources to each vertex of the graph
+     * @param sources Pairs of (vertex index, cost of getting to it)
+     * @return Path length for each vertex. HUGE_VAL for unreachable ones
+     */
+    std::vector<double> graph_distances(const std::vector<std::pair<size_t, double>> &sources) const;
+
+    /*!
+     * Find the shortest path in the visibility graph with A* from any of the sources to any of the targets
+     * @param sources Pairs of (vertex index, cost of getting to it)
+     * @param targets Pairs of (vertex index, cost of getting from it to the goal)
+     * @param goal The final point, all the targets should be connected to
+     * @return Vertices of the path from a source to a target. Empty if there is no such path
+     */
+    std::vector<point_t> a_star_path(const std::vector<std::pair<size_t, double>> &sources,
+                                     const std::vector<std::pair<size_t, double>> &targets, point_t goal) const;
 
     /*!
      * Find the shortest path between polygon nodes with index i and index j
@@ -66,13 +165,68 @@ private:
 
 public:
     /*!
-     * Main and the only constructor of the calculator.
+     * Number of visibility graph vertices starting from which the shortest paths are searched with A* on demand
+     * instead of being precomputed for all pairs with Floyd-Warshall
+     */
+    static constexpr size_t LAZY_SHORTEST_PATHS_MIN_VERTICES = 1000;
+
+    /*!
+     * Main constructor of the calculator. Builds the visibility graph and the shortest paths.
      * @param polygon polygon, bounds of which will define the shortest path
+     * @param thread_pool Pool to build the visibility graph and the shortest paths matrix on.
+     * nullptr to build everything in the calling thread
      */
-    explicit ShortestPathCalculator(const MapPolygon &polygon);
+    explicit ShortestPathCalculator(const MapPolygon &polygon, ThreadPool *thread_pool = nullptr);
+
+    /*!
+     * Restore the calculator from the shortest paths saved by save_paths(), skipping the visibility graph and
+     * the shortest paths calculation
+     * @throw shortest_paths_file_error if the data is corrupted, has another version or was saved for another polygon
+     * @param polygon The same polygon the paths were saved for
+     * @param paths Data produced by save_paths(), e.g. a memory-mapped file
+     * @param paths_size Size of the data in bytes
+     */
+    ShortestPathCalculator(const MapPolygon &polygon, const uint8_t *paths, size_t paths_size);
 
     ShortestPathCalculator() = delete;
 
+    /*!
+     * Serialize the visibility graph and the shortest paths matrices to a compact binary form
+     * @note The data can be loaded only for the same polygon, including the no-fly zones added by add_obstacle
+     * @return Binary data for the loading constructor
+     */
+    std::vector<uint8_t> save_paths() const;
+
+    /*!
+     * Hash of the polygon that does not depend on the starting points of its rings and on the order of no-fly zones
+     */
+    static uint64_t polygon_hash(const MapPolygon &polygon);
+
+    /*!
+     * Precompute the graph vertices seen from each of the points and the visibility between all pairs of them.
+     * Queries between these points then only combine the stored values. Replaces the previously registered points
+     * @param points Points that will be queried repeatedly, e.g. the start and end points of all the targets
+     * @param thread_pool Pool to run the visibility checks on. nullptr to run them in the calling thread
+     */
+    void register_query_points(const std::vector<point_t> &points, ThreadPool *thread_pool = nullptr);
+
+    /*!
+     * Add a temporary no-fly zone. Only the part of the visibility graph around it is rebuilt and only the shortest
+     * paths it affects are recalculated
+     * @param obstacle Polygon of the no-fly zone. Should lie inside of the fly-zone and not touch other no-fly zones
+     * @param thread_pool Pool to run the update on. nullptr to run in the calling thread
+     * @return Identifier of the no-fly zone to remove it later
+     */
+    size_t add_obstacle(polygon_t obstacle, ThreadPool *thread_pool = nullptr);
+
+    /*!
+     * Remove a no-fly zone added by add_obstacle
+     * @param id Identifier returned by add_obstacle
+     * @param thread_pool Pool to run the update on. nullptr to run in the calling thread
+     * @throws shortest_path_calculation_error if there is no no-fly zone with such identifier
+     */
+    void remove_obstacle(size_t id, ThreadPool *thread_pool = nullptr);
+
     /*!
      * Method for getting the approximate shortest path between two points
      * @note It works fine only all two points are located close to nodes of the map polygon.
@@ -91,6 +245,24 @@ public:
      */
     std::vector<point_t> shortest_path_between_points(point_t p1, point_t p2) const;
 
+    /*!
+     * Get the lengths of the shortest paths inside of the polygon from one point to many.
+     * The source is connected to the visibility graph only once for all the targets
+     * @param source Start point of all the paths
+     * @param targets End points of the paths
+     * @return Length of the path to each of the targets
+     */
+    std::vector<double> distances_from(point_t source, const std::vector<point_t> &targets) const;
+
+    /*!
+     * Get the lengths of the shortest paths inside of the polygon between each source and each target.
+     * Each point is connected to the visibility graph only once
+     * @param sources Start points of the paths
+     * @param targets End points of the paths
+     * @return Row-major matrix of size sources.size() x targets.size() with the path lengths
+     */
+    std::vector<double> distance_matrix(const std::vector<point_t> &sources, const std::vector<point_t> &targets) const;
+
 };
 
 
@@ -0,0 +1,83 @@
+#ifndef THESIS_TRAJECTORY_GENERATOR_SHORTESTPATHSTORE_HPP
+#define THESIS_TRAJECTORY_GENERATOR_SHORTESTPATHSTORE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ShortestPathCalculator.hpp"
+#include "SimpleLogger.h"
+
+/*!
+ * Directory of files with the precomputed shortest paths of the fields, named by the polygon hashes.
+ * The fields flown before are loaded from the memory-mapped files instead of being preprocessed again.
+ * Can be used from several threads
+ */
+class ShortestPathStore {
+public:
+    /*!
+     * @param directory Directory with the files. Created when the first file is saved. Empty to disable the files
+     * @param logger Logger for the loaded and saved files
+     */
+    ShortestPathStore(std::string directory, std::shared_ptr<loggers::SimpleLogger> logger);
+
+    /*!
+     * Get the calculator for the polygon. Loads it from the file of the polygon if there is one, otherwise builds
+     * it and saves the file for the next time
+     * @param polygon Polygon of the field
+     * @param thread_pool Pool to build the calculator on. nullptr to build it in the calling thread
+     * @return Calculator for the polygon
+     */
+    ShortestPathCalculator get(const MapPolygon &polygon, ThreadPool *thread_pool) const;
+
+    /*!
+     * Start reading all the files in the directory into the page cache, so that the first requests for the stored
+     * fields do not wait for the disk. Nothing is kept mapped or allocated by the store
+     * @return Number of the files being read
+     */
+    size_t warm_up() const;
+
+private:
+    /*!
+     * Read-only memory mapping of a whole file
+     */
+    class MappedFile {
+    public:
+        /*!
+         * @param file_name File to map
+         * @return The mapping or nullptr if the file cannot be opened or is empty
+         */
+        static std::unique_ptr<const MappedFile> open(const std::string &file_name);
+
+        MappedFile(const uint8_t *data, size_t size) : m_data{data}, m_size{size} {}
+
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile();
+
+        [[nodiscard]] const uint8_t *data() const { return m_data; }
+
+        [[nodiscard]] size_t size() const { return m_size; }
+
+    private:
+        const uint8_t *m_data;
+        size_t m_size;
+    };
+
+    static constexpr const char *FILE_EXTENSION = ".paths";
+
+    std::string m_directory;
+    std::shared_ptr<loggers::SimpleLogger> m_logger;
+
+    [[nodiscard]] std::string file_name(uint64_t hash) const;
+
+    /*!
+     * Write the file through a temporary one, so that other processes never map a partially written file
+     * @return false if the file could not be written
+     */
+    bool save(const std::string &file_name, const std::vector<uint8_t> &data) const;
+};
+
+#endif //THESIS_TRAJECTORY_GENERATOR_SHORTESTPATHSTORE_HPP
@@ -0,0 +1,137 @@
+#ifndef THESIS_TRAJECTORY_GENERATOR_SPATIALINDEX_HPP
+#define THESIS_TRAJECTORY_GENERATOR_SPATIALINDEX_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "custom_types.hpp"
+
+/*!
+ * Uniform grid over the bounding box of a set of segments. Each cell stores the segments passing through it
+ * (with a small margin), so that only the segments near a query ray are checked
+ */
+class SegmentGrid {
+public:
+    SegmentGrid() = default;
+
+    /*!
+     * Build the grid with approximately one cell per segment
+     * @param segments Indexed segments
+     */
+    explicit SegmentGrid(const std::vector<segment_t> &segments);
+
+    /*!
+     * Check the predicate on the indices of segments registered in the cells crossed by the query segment.
+     * A segment may be passed several times if it is registered in several crossed cells.
+     * Each segment intersecting the query one (or touching it) is passed at least once
+     * @param segment Query segment
+     * @param predicate Function bool(size_t segment_index). The traversal stops when it returns true
+     * @return true if the predicate returned true for any segment
+     */
+    template<typename Predicate>
+    bool any_segment_along(const segment_t &segment, Predicate predicate) const;
+
+    /*!
+     * Clip the segment to the rectangle using the Liang-Barsky algorithm
+     * @return false if the segment does not intersect the rectangle
+     */
+    static bool clip_segment(double min_x, double min_y, double max_x, double max_y, point_t &a, point_t &b);
+
+private:
+    [[nodiscard]] long cell_x(double x) const {
+        return std::clamp(static_cast<long>(std::floor((x - m_min_x) / m_cell_size)), 0L, m_nx - 1);
+    }
+
+    [[nodiscard]] long cell_y(double y) const {
+        return std::clamp(static_cast<long>(std::floor((y - m_min_y) / m_cell_size)), 0L, m_ny - 1);
+    }
+
+    double m_min_x = 0, m_min_y = 0;
+    double m_cell_size = 1;
+    long m_nx = 0, m_ny = 0;
+
+    // Segments of cell (ix, iy) are m_cell_segments[m_cell_start[iy * m_nx + ix] .. m_cell_start[iy * m_nx + ix + 1])
+    std::vector<uint32_t> m_cell_start;
+    std::vector<uint32_t> m_cell_segments;
+};
+
+
+/*!
+ * Static 2-d tree for the nearest point queries
+ */
+class PointKdTree {
+public:
+    PointKdTree() = default;
+
+    explicit PointKdTree(const std::vector<point_t> &points);
+
+    /*!
+     * Find the closest point. Of several equally close points, the one with the lowest index is returned
+     * @param p Query point
+     * @return Index of the closest point in the vector passed to the constructor
+     */
+    [[nodiscard]] size_t nearest(point_t p) const;
+
+    [[nodiscard]] bool empty() const { return m_nodes.empty(); }
+
+private:
+    /*!
+     * Arrange m_nodes[begin, end) so that the median by the axis is in the middle, and recursively the same for
+     * both halves with the other axis
+     */
+    void build(size_t begin, size_t end, int axis);
+
+    void nearest(point_t p, size_t begin, size_t end, int axis, size_t &best, double &best_distance) const;
+
+    std::vector<point_t> m_points;
+    std::vector<size_t> m_nodes; // Indices of points in the tree order
+};
+
+
+template<typename Predicate>
+bool SegmentGrid::any_segment_along(const segment_t &segment, Predicate predicate) const {
+    if (m_nx == 0) {
+        return false;
+    }
+    point_t a = segment.first, b = segment.second;
+    if (!clip_segment(m_min_x, m_min_y, m_min_x + static_cast<double>(m_nx) * m_cell_size,
+                      m_min_y + static_cast<double>(m_ny) * m_cell_size, a, b)) {
+        return false;
+    }
+
+    // Grid traversal by Amanatides and Woo
+    long ix = cell_x(a.first), iy = cell_y(a.second);
+    double dx = b.first - a.first, dy = b.second - a.second;
+    long step_x = dx > 0 ? 1 : -1, step_y = dy > 0 ? 1 : -1;
+    double t_max_x = dx == 0 ? HUGE_VAL :
+                     (m_min_x + static_cast<double>(ix + (step_x > 0)) * m_cell_size - a.first) / dx;
+    double t_max_y = dy == 0 ? HUGE_VAL :
+                     (m_min_y + static_cast<double>(iy + (step_y > 0)) * m_cell_size - a.second) / dy;
+    double t_delta_x = dx == 0 ? HUGE_VAL : m_cell_size / std::abs(dx);
+    double t_delta_y = dy == 0 ? HUGE_VAL : m_cell_size / std::abs(dy);
+
+    while (true) {
+        size_t cell = static_cast<size_t>(iy * m_nx + ix);
+        for (uint32_t i = m_cell_start[cell]; i < m_cell_start[cell + 1]; ++i) {
+            if (predicate(static_cast<size_t>(m_cell_segments[i]))) {
+                return true;
+            }
+        }
+        if (std::min(t_max_x, t_max_y) > 1) {
+            return false;
+        }
+        if (t_max_x < t_max_y) {
+            ix += step_x;
+            t_max_x += t_delta_x;
+        } else {
+            iy += step_y;
+            t_max_y += t_delta_y;
+        }
+        if (ix < 0 || ix >= m_nx || iy < 0 || iy >= m_ny) {
+            return false;
+        }
+    }
+}
+
+#endif //THESIS_TRAJECTORY_GENERATOR_SPATIALINDEX_HPP
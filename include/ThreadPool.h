@@ -0,0 +1,53 @@
+#ifndef THESIS_TRAJECTORY_GENERATOR_THREADPOOL_H
+#define THESIS_TRAJECTORY_GENERATOR_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * Fixed set of worker threads for data-parallel loops.
+ * The calling thread also takes part in each loop, so nested loops from inside the workers do not deadlock
+ */
+class ThreadPool {
+public:
+    /*!
+     * @param n_threads Total number of threads working on a loop including the calling one.
+     * 0 for the number of hardware threads
+     */
+    explicit ThreadPool(size_t n_threads = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /*!
+     * @return Number of threads working on a loop including the calling one
+     */
+    [[nodiscard]] size_t size() const { return m_workers.size() + 1; }
+
+    /*!
+     * Call f(begin, end) for chunks covering [0, n) in parallel and wait until all of them are processed.
+     * If any call throws, the first exception is rethrown after all the chunks are finished
+     * @param n Number of loop iterations
+     * @param f Function processing iterations [begin, end)
+     * @param min_chunk Minimum number of iterations in one chunk
+     */
+    void parallel_for(size_t n, const std::function<void(size_t, size_t)> &f, size_t min_chunk = 1);
+
+private:
+    void worker_loop();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_stop = false;
+};
+
+#endif //THESIS_TRAJECTORY_GENERATOR_THREADPOOL_H
@@ -2,6 +2,7 @@
 #define THESIS_TRAJECTORY_GENERATOR_MSTSPSOLVER_H
 
 #include "SolverConfig.h"
+#include "SolverStats.h"
 #include "TargetSet.h"
 #include <vector>
 #include "MapPolygon.hpp"
@@ -9,11 +10,18 @@
 #include "ShortestPathCalculator.hpp"
 #include "custom_types.hpp"
 #include <SimpleLogger.h>
+#include <functional>
+#include <list>
+#include <random>
 
 struct metaheuristic_application_error : public std::runtime_error {
     using runtime_error::runtime_error;
 };
 
+struct checkpoint_error : public std::runtime_error {
+    using runtime_error::runtime_error;
+};
+
 // Use a custom struct.
 // The Reference3D from ROS is not used to make some modules completely independent of ROS
 template<typename T=double>
@@ -71,6 +79,29 @@ namespace mstsp_solver {
         double max_path_energy;
         double path_energies_sum;
         std::vector<std::vector<point_heading_t < double>>> paths;
+        _instance_solution_t solution; // Targets visited by each UAV. Can be used to warm-start replan()
+        solver_stats_t stats; // Statistics of the search that produced this solution
+    };
+
+    /*!
+     * State of the tabu search between two iterations.
+     * The search can be interrupted, saved as a checkpoint and resumed later from exactly the same point
+     */
+    struct solver_state_t {
+        _instance_solution_t best_solution;
+        solution_cost_t best_solution_cost = solution_cost_t::max();
+        _instance_solution_t current_solution; // The best solution of the last neighbourhood
+        std::list<_instance_solution_t> tabu_list;
+
+        int g1_score = 0;
+        int g2_score = 0;
+        int g3_score = 0;
+        int g4_score = 0;
+        int R_T_iterator = 0;
+        int iteration = 0;
+        int no_improvement_iteration = 0;
+
+        std::mt19937 random_generator;
     };
 
 
@@ -90,6 +121,50 @@ namespace mstsp_solver {
          */
         final_solution_t solve() const;
 
+        /*!
+         * Run (or continue) the search from the specified state
+         * @param state State to start from, e.g. from initial_state() or load_checkpoint(). Updated during the search,
+         * so if the search is interrupted, it can be saved and resumed later
+         * @param stop_requested Function called between iterations. If it returns true, the search is interrupted
+         * @return The best solution found so far
+         */
+        final_solution_t solve(solver_state_t &state, const std::function<bool()> &stop_requested = {}) const;
+
+        /*!
+         * @return State with the greedy initial solution from which the search can be started
+         */
+        solver_state_t initial_state() const;
+
+        /*!
+         * Serialize the search state to a compact binary checkpoint.
+         * @note Targets are saved by their indices, so the checkpoint can be loaded only by a solver for the same problem
+         * @param state State to be saved
+         * @return Binary checkpoint
+         */
+        std::vector<uint8_t> save_checkpoint(const solver_state_t &state) const;
+
+        /*!
+         * Restore the search state from a binary checkpoint
+         * @throw checkpoint_error if the checkpoint is corrupted or was saved for a different problem
+         * @param checkpoint Checkpoint produced by save_checkpoint()
+         * @return State from which the search can be resumed with solve(state)
+         */
+        solver_state_t load_checkpoint(const std::vector<uint8_t> &checkpoint) const;
+
+        /*!
+         * Re-plan the problem when only the starting point or altitudes changed.
+         * The decomposition and targets of this solver are reused and only the legs to and from the starting
+         * point are recalculated, so a short tabu search warm-started from the previous solution is enough
+         * @param starting_point New starting (and finishing) point of all the UAVs
+         * @param sweeping_alt New altitude of sweeping
+         * @param unique_alt_step New altitude difference between UAVs while not sweeping
+         * @param previous_solution Solution returned by the previous solve() or replan() call of this solver
+         * @param max_not_improving_iterations Number of iterations with no improvement before stopping
+         * @return Solution of the problem with the new starting point
+         */
+        final_solution_t replan(point_t starting_point, double sweeping_alt, double unique_alt_step,
+                                const _instance_solution_t &previous_solution, int max_not_improving_iterations);
+
         void set_logger(std::shared_ptr<loggers::SimpleLogger> new_logger) {
             m_logger = std::move(new_logger);
         }
@@ -97,16 +172,68 @@ namespace mstsp_solver {
     private:
         std::shared_ptr<loggers::SimpleLogger> m_logger;
         std::vector<TargetSet> m_target_sets;
-        const SolverConfig m_config;
+        SolverConfig m_config;
         const EnergyCalculator m_energy_calculator;
         ShortestPathCalculator m_shortest_path_calculator;
         double m_cost_constant = 0.0001;
 
+        // Points between which the UAVs fly outside of targets: the starting point first, then the target endpoints
+        std::vector<point_t> m_transition_points;
+        // Row-major matrix of the energies of flying between the transition points along the shortest paths
+        std::vector<double> m_transition_energies;
+        static constexpr size_t STARTING_POINT_TRANSITION = 0;
+
+        /*!
+         * Calculate the energies of transitions between all the target endpoints and the starting point and store
+         * the indices of the endpoints in the targets
+         */
+        void compute_transition_energies();
+
+        /*!
+         * Recalculate the transition energies from and to the starting point after it changed
+         */
+        void update_starting_point_transitions();
+
         /*!
          * Generate a solution using a greedy random method
+         * @param random_generator Generator of the search state
          * @return greedy solution
          */
-        _instance_solution_t greedy_random() const;
+        _instance_solution_t greedy_random(std::mt19937 &random_generator) const;
+
+        /*!
+         * Generate a solution by regret-k insertion: at each step, insert the target set for which the difference
+         * between its best insertion and k - 1 next best ones is the largest
+         * @param k Number of best insertions to consider (2 for regret-2 etc.)
+         * @return regret-k solution
+         */
+        _instance_solution_t regret_insertion(size_t k) const;
+
+        /*!
+         * Create the initial search state from a solution
+         * @param init_solution Solution to start the search from
+         * @param random_generator Generator the search continues with
+         * @return Search state before the first iteration
+         */
+        solver_state_t state_from_solution(const _instance_solution_t &init_solution,
+                                           const std::mt19937 &random_generator) const;
+
+        /*!
+         * Improve the solution using the tabu search with adaptive operator selection
+         * @param state Search state to start from. Updated with each iteration
+         * @param max_not_improving_iterations Number of iterations with no improvement before stopping
+         * @param stop_requested Function called between iterations to interrupt the search. Can be empty
+         * @return The best found solution
+         */
+        final_solution_t tabu_search(solver_state_t &state, int max_not_improving_iterations,
+                                     const std::function<bool()> &stop_requested) const;
+
+        /*!
+         * @param random_generator Generator of the search state. Kept only in the state, so that searches on the same
+         * solver do not share it
+         * @return random number in range [0, max(int)]
+         */
+        static int random_number(std::mt19937 &random_generator);
 
         /*!
          * Get the estimated energy consumption of the path
@@ -115,6 +242,24 @@ namespace mstsp_solver {
          */
         double get_path_energy(const std::vector<Target> &path) const;
 
+        /*!
+         * Get the estimated energy consumption of a transition between two points along the shortest path around
+         * no-fly zones
+         * @param from Index of the start point of the transition in m_transition_points
+         * @param to Index of the end point of the transition in m_transition_points
+         * @return Energy consumption in [J]
+         */
+        double get_transition_energy(size_t from, size_t to) const {
+            return m_transition_energies[from * m_transition_points.size() + to];
+        }
+
+        /*!
+         * Get the energy consumption of flying along a straight line, starting and ending with zero speed
+         * @param distance Length of the line
+         * @return Energy consumption in [J]
+         */
+        double get_straight_line_energy(double distance) const;
+
         /*!
          * Calculate the cost of one path
          * @param path Sequence of targets, cost for which should be calculated
@@ -160,26 +305,30 @@ namespace mstsp_solver {
         /*!
          * Apply step 1: Random Shift
          * @param solution solution to modify
+         * @param random_generator Generator of the search state
          */
-        void get_g1_solution(_instance_solution_t &solution) const;
+        void get_g1_solution(_instance_solution_t &solution, std::mt19937 &random_generator) const;
 
         /*!
          * Apply step 2: Best shift
          * @param solution solution to modify
+         * @param random_generator Generator of the search state
          */
-        void get_g2_solution(_instance_solution_t &solution) const;
+        void get_g2_solution(_instance_solution_t &solution, std::mt19937 &random_generator) const;
 
         /*!
          * Apply step 3: Best swap
          * @param solution solution to modify
+         * @param random_generator Generator of the search state
          */
-        void get_g3_solution(_instance_solution_t &solution) const;
+        void get_g3_solution(_instance_solution_t &solution, std::mt19937 &random_generator) const;
 
         /*!
          * Apply step 4: Direction change
          * @param solution solution to modify
+         * @param random_generator Generator of the search state
          */
-        void get_g4_solution(_instance_solution_t &solution) const;
+        void get_g4_solution(_instance_solution_t &solution, std::mt19937 &random_generator) const;
 
         /*!
          * Given two nodes, select the best replacements from the same sets for them
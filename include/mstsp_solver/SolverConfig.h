@@ -7,6 +7,7 @@
 
 #include "utils.hpp"
 #include <vector>
+#include <string>
 
 namespace mstsp_solver {
     struct SolverConfig {
@@ -24,6 +25,10 @@ namespace mstsp_solver {
         int R_T = 20;
         int w0 = 5;
 
+        int initial_solution_regret = 0; // 0 for the greedy random initial solution, k >= 2 for regret-k insertion
+
+        std::string convergence_trace_file{}; // If not empty, the per-iteration convergence trace is saved to this CSV file
+
     };
 }
 #endif //THESIS_TRAJECTORY_GENERATOR_SOLVERCONFIG_H
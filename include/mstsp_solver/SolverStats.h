@@ -0,0 +1,47 @@
+#ifndef THESIS_TRAJECTORY_GENERATOR_SOLVERSTATS_H
+#define THESIS_TRAJECTORY_GENERATOR_SOLVERSTATS_H
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace mstsp_solver {
+
+    /*!
+     * Statistics of one neighbourhood operator (G1 - G4) of the tabu search
+     */
+    struct operator_stats_t {
+        size_t calls = 0;
+        double time = 0; // Total time spent in the operator [s]
+        size_t best_in_neighbourhood = 0; // How many times the operator produced the best solution of a neighbourhood
+        size_t improvements = 0; // How many times the operator improved the best solution
+    };
+
+    /*!
+     * Snapshot of the search after one iteration
+     */
+    struct convergence_record_t {
+        int iteration;
+        double time; // Time from the start of the search [s]
+        double best_max_path_cost;
+        double best_path_cost_sum;
+        std::array<int, 4> operator_scores; // Adaptive scores of G1 - G4 at the end of the iteration
+    };
+
+    struct solver_stats_t {
+        std::array<operator_stats_t, 4> operators; // Statistics of G1 - G4 operators
+        std::vector<convergence_record_t> convergence;
+        int iterations = 0;
+        double time = 0; // Total search time [s]
+    };
+
+    /*!
+     * Save the per-iteration convergence trace as a CSV file
+     * @param stats Solver statistics with the trace
+     * @param filename Path to the output file
+     * @throw std::runtime_error if the file cannot be written
+     */
+    void save_convergence_trace(const solver_stats_t &stats, const std::string &filename);
+}
+
+#endif //THESIS_TRAJECTORY_GENERATOR_SOLVERSTATS_H
@@ -16,6 +16,9 @@ namespace mstsp_solver {
         point_t end_point;
         size_t target_set_index;
         size_t target_index;
+        // Indices of the endpoints in the transition energy matrix of the solver. Set when the solver is constructed
+        size_t starting_point_transition = 0;
+        size_t end_point_transition = 0;
 
         bool operator==(const Target &rhs) const {
             return target_index == rhs.target_index && target_set_index == rhs.target_set_index;
@@ -18,7 +18,6 @@ namespace mstsp_solver {
         size_t index;
         MapPolygon polygon;
         std::vector<Target> targets;
-        EnergyCalculator energy_calculator;
         double sweeping_step;
         double m_wall_distance;
 
@@ -27,24 +26,26 @@ namespace mstsp_solver {
                 TargetSet(index, polygon, sweeping_step, wall_distance, energy_calculator, std::vector<double>{0, M_PI}) {};
 
         TargetSet(size_t index, const MapPolygon &polygon, double sweeping_step, double wall_distance,
-                  EnergyCalculator energy_calculator, const std::vector<double> &rotation_angles);
+                  const EnergyCalculator &energy_calculator, const std::vector<double> &rotation_angles);
 
         TargetSet(size_t index, const MapPolygon &polygon, double sweeping_step, double wall_distance,
-                  EnergyCalculator energy_calculator, size_t number_of_edges_rotations);
+                  const EnergyCalculator &energy_calculator, size_t number_of_edges_rotations);
 
     private:
         /*!
          * Delete all the stored nodes and add new ones, with rotation angle of each as angles
          * @param angles sweeping angles of inserted nodes
+         * @param energy_calculator Calculator of the sweeping paths energy
          */
-        void set_rotation_angles(const std::vector<double>& angles);
+        void set_rotation_angles(const std::vector<double>& angles, const EnergyCalculator &energy_calculator);
 
         /*!
          * Generate 2 nodes corresponding to the given rotation angle and store it
          * @param angle Rotation angle for sweeping
          * @param up If the first sweep should go up
+         * @param energy_calculator Calculator of the sweeping path energy
          */
-        void add_one_rotation_angle(double angle, bool up);
+        void add_one_rotation_angle(double angle, bool up, const EnergyCalculator &energy_calculator);
     };
 }
 
@@ -1,6 +1,7 @@
 #ifndef MAP_TO_GRAPH_UTILS_HPP
 #define MAP_TO_GRAPH_UTILS_HPP
 
+#include <cstdint>
 #include <tuple>
 #include <vector>
 #include "custom_types.hpp"
@@ -152,6 +153,20 @@ std::pair<double, double> solve_quadratic(double a, double b, double c);
  */
 point_t segment_vertical_line_intersection(const segment_t &s, double x);
 
+/*!
+ * Finalizer of splitmix64. Spreads every input bit over the whole result, so it is used to combine values into hashes
+ * @param x Value to mix
+ * @return Mixed value
+ */
+inline uint64_t hash_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
 
 
 #endif
@@ -72,6 +72,8 @@ EnergyCalculator::EnergyCalculator(const energy_calculator_config_t &energy_calc
 
     v_r = v_i_h / v_r_inv;
 
+    build_turning_table();
+
     m_logger->log_info(
             "ENERGY CALCULATOR: Optimal speed: " + std::to_string(v_r) + "Time of flight: " +
             std::to_string(t_r) + " Hover power consumption: " + std::to_string(P_h) + " Optimal speed power consumption: "  + std::to_string(P_r));
@@ -111,8 +113,38 @@ turning_properties_t EnergyCalculator::calculate_turning_properties(double angle
     return {v_in, -a_y, v_in, a_y, energy, vy_m};
 }
 
-double EnergyCalculator::calculate_straight_line_energy(double v_in, double a_in, double v_out, double a_out,
-                                                        double s_tot) const {
+void EnergyCalculator::build_turning_table() {
+    auto table = std::make_shared<std::vector<turning_properties_t>>();
+    table->reserve(TURNING_TABLE_SIZE);
+    double step = TURNING_TABLE_MAX_ANGLE / (TURNING_TABLE_SIZE - 1);
+    for (size_t i = 0; i < TURNING_TABLE_SIZE; ++i) {
+        table->push_back(calculate_turning_properties(std::min(static_cast<double>(i) * step, TURNING_TABLE_MAX_ANGLE)));
+    }
+    m_turning_table = std::move(table);
+    m_turning_table_inv_step = 1 / step;
+}
+
+turning_properties_t EnergyCalculator::get_turning_properties(double angle) const {
+    angle = std::abs(angle);
+    // Near 0, the exact formula jumps from the value at 0 (full reversal) to the limit of tiny turns, so it is not
+    // interpolated there
+    double position = angle * m_turning_table_inv_step;
+    if (position < 1 || angle > TURNING_TABLE_MAX_ANGLE) {
+        return calculate_turning_properties(angle);
+    }
+
+    const auto &table = *m_turning_table;
+    auto i = std::min(static_cast<size_t>(position), TURNING_TABLE_SIZE - 2);
+    double t = position - static_cast<double>(i);
+    const auto &p0 = table[i];
+    const auto &p1 = table[i + 1];
+    auto lerp = [t](double a, double b) { return a + (b - a) * t; };
+    return {lerp(p0.v_before, p1.v_before), lerp(p0.a_before, p1.a_before), lerp(p0.v_after, p1.v_after),
+            lerp(p0.a_after, p1.a_after), lerp(p0.energy, p1.energy), lerp(p0.d_vym, p1.d_vym)};
+}
+
+energy_time_t EnergyCalculator::calculate_straight_line_energy(double v_in, double a_in, double v_out, double a_out,
+                                                               double s_tot) const {
     // Calculate the time and distance travelled during the acceleration and deceleration phases
     double t_acc = std::abs(v_r - v_in) / a_in;
     double s_acc = v_in * t_acc + 0.5 * a_in * std::pow(t_acc, 2);
@@ -122,25 +154,25 @@ double EnergyCalculator::calculate_straight_line_energy(double v_in, double a_in
 
 
     if (s_acc + s_dec <= s_tot) {
-        m_total_path_time += t_acc + t_dec;
-        m_total_path_time += (s_tot - s_acc - s_dec) / v_r;
-        return ((s_tot - s_acc - s_dec) / v_r) * P_r +
-               calculate_acceleration_energy(v_in, v_r, t_acc) +
-               calculate_acceleration_energy(v_out, v_r, t_dec);
+        double t_const = (s_tot - s_acc - s_dec) / v_r;
+        return {t_const * P_r +
+                calculate_acceleration_energy(v_in, v_r, t_acc) +
+                calculate_acceleration_energy(v_out, v_r, t_dec),
+                t_acc + t_dec + t_const};
     } else {
         return calculate_short_line_energy(v_in, a_in, v_out, a_out, s_tot);
     }
 }
 
-double EnergyCalculator::calculate_straight_line_energy(double v_in, double a_in, double v_out, double a_out,
-                                                        const std::pair<double, double> &p1,
-                                                        const std::pair<double, double> &p2) const {
+energy_time_t EnergyCalculator::calculate_straight_line_energy(double v_in, double a_in, double v_out, double a_out,
+                                                               const std::pair<double, double> &p1,
+                                                               const std::pair<double, double> &p2) const {
     return calculate_straight_line_energy(v_in, a_in, v_out, a_out, distance_between_points(p1, p2));
 }
 
-double EnergyCalculator::calculate_straight_line_energy_between_turns(const turning_properties_t &turn1,
-                                                                      const turning_properties_t &turn2,
-                                                                      double s_tot) const {
+energy_time_t EnergyCalculator::calculate_straight_line_energy_between_turns(const turning_properties_t &turn1,
+                                                                             const turning_properties_t &turn2,
+                                                                             double s_tot) const {
 
     double t_acc_slow = std::abs((turn1.v_after - turn1.d_vym) / turn1.a_after);
     double s_acc_slow = turn1.d_vym * t_acc_slow + 0.5 * turn1.a_after * std::pow(t_acc_slow, 2);
@@ -151,13 +183,12 @@ double EnergyCalculator::calculate_straight_line_energy_between_turns(const turn
 
     // If the segment is not too short for at least slow acceleration and slow deceleration -- do it
     if (s_acc_slow + s_dec_slow < s_tot) {
-        m_total_path_time += t_acc_slow + t_dec_slow;
         double slow_acceleration_energy = calculate_acceleration_energy(turn1.d_vym, turn1.v_after, t_acc_slow);
         slow_acceleration_energy += calculate_acceleration_energy(turn2.d_vym, turn2.v_after, t_dec_slow);
 
         return calculate_straight_line_energy(turn1.v_after, config.average_acceleration, turn2.v_before,
                                               -config.average_acceleration, s_tot - s_acc_slow - s_dec_slow) +
-               slow_acceleration_energy;
+               energy_time_t{slow_acceleration_energy, t_acc_slow + t_dec_slow};
     } else {
         // If the UAV can only start the slow deceleration after the slow acceleration
         return calculate_short_line_energy(turn1.d_vym, turn1.a_after, turn2.d_vym, turn2.a_before,
@@ -165,10 +196,10 @@ double EnergyCalculator::calculate_straight_line_energy_between_turns(const turn
     }
 }
 
-double
+energy_time_t
 EnergyCalculator::calculate_short_line_energy(double v_in, double a_in, double v_out, double a_out, double s) const {
     if (s == 0) {
-        return 0;
+        return {0, 0};
     }
 
     auto v_sol = std::sqrt(
@@ -177,8 +208,7 @@ EnergyCalculator::calculate_short_line_energy(double v_in, double a_in, double v
     // If there is no solution as it's impossible to enter and leave the segment with specified speeds having these accelerations
     if (std::isnan(v_sol) || v_sol < v_in || v_sol < v_out || v_sol > v_r) {
         auto middle_speed = (v_out + v_in) / 2;
-        m_total_path_time += s / middle_speed;
-        return s / middle_speed * (P_h + (P_r - P_h) * middle_speed / v_r);
+        return {s / middle_speed * (P_h + (P_r - P_h) * middle_speed / v_r), s / middle_speed};
     }
     double t_acc = (v_sol - v_in) / a_in;
     double s_acc = v_in * t_acc + 0.5 * a_in * t_acc * t_acc;
@@ -188,48 +218,191 @@ EnergyCalculator::calculate_short_line_energy(double v_in, double a_in, double v
 
 
     if (s_acc > 0 && s_dec > 0) {
-        m_total_path_time += t_acc + t_dec;
-        return calculate_acceleration_energy(v_in, v_sol, t_acc) + calculate_acceleration_energy(v_out, v_sol, t_dec);
+        return {calculate_acceleration_energy(v_in, v_sol, t_acc) + calculate_acceleration_energy(v_out, v_sol, t_dec),
+                t_acc + t_dec};
     }
 
     // Should not get here as if v_sol exists, s_acc and s_dec should be positive
     m_logger->log_debug("Warning: Too short segment");
-    return 0.0;
+    return {0.0, 0.0};
 }
 
 
 double EnergyCalculator::calculate_path_energy_consumption(const std::vector<std::pair<double, double>> &path) const {
+    return calculate_path_energy_and_time(path).energy;
+}
+
+
+energy_time_t
+EnergyCalculator::calculate_path_energy_and_time(const std::vector<std::pair<double, double>> &path) const {
     if (path.size() < 2) {
-        return 0;
+        return {0, 0};
+    }
+    static_assert(sizeof(std::pair<double, double>) == 2 * sizeof(double), "Pair of doubles must not be padded");
+
+    uint32_t offsets[] = {0, static_cast<uint32_t>(path.size())};
+    return calculate_batch_path_energy(path_batch_t{&path[0].first, &path[0].second, 2, offsets, 1}, 0, path.size());
+}
+
+
+void EnergyCalculator::calculate_path_energy_batch(const path_batch_t &batch, energy_time_t *out) const {
+    for (size_t i = 0; i < batch.n_paths; ++i) {
+        out[i] = calculate_batch_path_energy(batch, batch.offsets[i], batch.offsets[i + 1]);
     }
+}
+
+
+void EnergyCalculator::calculate_path_energy_batch(const path_batch_f32_t &batch, energy_time_t *out) const {
+    for (size_t i = 0; i < batch.n_paths; ++i) {
+        out[i] = calculate_batch_path_energy(batch, batch.offsets[i], batch.offsets[i + 1]);
+    }
+}
+
 
-    // Filter the path by removing points in the same location
-    std::vector<std::pair<double, double>> path_filtered;
-    path_filtered.reserve(path.size());
-    path_filtered.push_back(path[0]);
-    for (size_t i = 1; i < path.size(); ++i) {
-        if (distance_between_points(path[i], path[i - 1]) != 0) {
-            path_filtered.push_back(path[i]);
+template<typename T>
+energy_time_t
+EnergyCalculator::calculate_batch_path_energy(const basic_path_batch_t<T> &batch, size_t begin, size_t end) const {
+    // The path is processed in blocks of filtered points. The last two points of a block and the turn at the first of
+    // them are carried to the next block, as segments can only be finished when the turn at their end is known
+    constexpr size_t BLOCK_SIZE = 64;
+    double x[BLOCK_SIZE], y[BLOCK_SIZE], squared_length[BLOCK_SIZE], length[BLOCK_SIZE], angle[BLOCK_SIZE];
+    turning_properties_t turns[BLOCK_SIZE];
+    // Quantised turn angles and lengths. Used only with the segment cache
+    uint32_t turn_keys[BLOCK_SIZE];
+    uint64_t length_keys[BLOCK_SIZE];
+    SegmentEnergyCache *cache = m_segment_cache.get();
+    turn_keys[0] = SegmentEnergyCache::START_TURN_KEY;
+
+    energy_time_t total{0, 0};
+    turns[0] = get_start_turn();
+    const turning_properties_t stop_turn = get_stop_turn();
+
+    size_t n = 0;
+    size_t next = begin;
+    while (true) {
+        // Filter the path by removing points in the same location as the previous one
+        for (; next < end && n < BLOCK_SIZE; ++next) {
+            auto px = static_cast<double>(batch.x[next * batch.stride]);
+            auto py = static_cast<double>(batch.y[next * batch.stride]);
+            if (n == 0 || px != x[n - 1] || py != y[n - 1]) {
+                x[n] = px;
+                y[n] = py;
+                ++n;
+            }
         }
+        bool last_block = next == end;
+        if (n < 2) {
+            return total;
+        }
+
+        for (size_t i = 0; i + 1 < n; ++i) {
+            double dx = x[i + 1] - x[i];
+            double dy = y[i + 1] - y[i];
+            squared_length[i] = dx * dx + dy * dy;
+            length[i] = std::sqrt(squared_length[i]);
+        }
+
+        // Same as angle_between_points, but with already known lengths of the adjacent segments
+        for (size_t i = 1; i + 1 < n; ++i) {
+            double dx = x[i + 1] - x[i - 1];
+            double dy = y[i + 1] - y[i - 1];
+            double cos_angle = (squared_length[i - 1] + squared_length[i] - (dx * dx + dy * dy)) /
+                               std::sqrt(4 * squared_length[i - 1] * squared_length[i]);
+            angle[i] = (cos_angle < -1 || cos_angle > 1) ? 0 : std::acos(cos_angle);
+        }
+
+        if (cache) {
+            for (size_t i = 0; i + 1 < n; ++i) {
+                length_keys[i] = SegmentEnergyCache::length_key(length[i]);
+                length[i] = static_cast<double>(length_keys[i]) * SegmentEnergyCache::LENGTH_QUANTUM;
+            }
+            for (size_t i = 1; i + 1 < n; ++i) {
+                turn_keys[i] = SegmentEnergyCache::angle_key(angle[i]);
+                angle[i] = turn_keys[i] * SegmentEnergyCache::ANGLE_QUANTUM;
+            }
+        }
+
+        for (size_t i = 1; i + 1 < n; ++i) {
+            turns[i] = get_turning_properties(angle[i]);
+        }
+
+        size_t n_segments = n - 2;
+        if (last_block) {
+            turns[n - 1] = stop_turn;
+            turn_keys[n - 1] = SegmentEnergyCache::STOP_TURN_KEY;
+            n_segments = n - 1;
+        }
+        for (size_t i = 0; i < n_segments; ++i) {
+            total.energy += turns[i].energy;
+            energy_time_t segment;
+            if (!cache || !cache->find(turn_keys[i], turn_keys[i + 1], length_keys[i], segment.energy, segment.time)) {
+                segment = calculate_straight_line_energy_between_turns(turns[i], turns[i + 1], length[i]);
+                if (cache) {
+                    cache->insert(turn_keys[i], turn_keys[i + 1], length_keys[i], segment.energy, segment.time);
+                }
+            }
+            total += segment;
+        }
+
+        if (last_block) {
+            return total;
+        }
+        x[0] = x[n - 2];
+        y[0] = y[n - 2];
+        x[1] = x[n - 1];
+        y[1] = y[n - 1];
+        turns[0] = turns[n - 2];
+        turn_keys[0] = turn_keys[n - 2];
+        n = 2;
+    }
+}
+
+
+energy_time_t EnergyCalculator::calculate_path_energy_from_geometry(const double *lengths, const double *angles,
+                                                                    size_t n_segments) const {
+    energy_time_t total{0, 0};
+    auto turn = get_start_turn();
+    uint32_t turn_key = SegmentEnergyCache::START_TURN_KEY;
+    for (size_t i = 0; i < n_segments; ++i) {
+        turning_properties_t next_turn = get_stop_turn();
+        uint32_t next_turn_key = SegmentEnergyCache::STOP_TURN_KEY;
+        if (i + 1 < n_segments) {
+            next_turn = get_path_turn(angles[i + 1], next_turn_key);
+        }
+        total.energy += turn.energy;
+        total += get_path_segment_energy(turn, turn_key, next_turn, next_turn_key, lengths[i]);
+        turn = next_turn;
+        turn_key = next_turn_key;
     }
+    return total;
+}
+
 
-    double total_energy = 0;
-    std::vector<turning_properties_t> turns;
-    turns.push_back({0, 0, 0, config.average_acceleration, config.drone_mass * std::pow(v_r, 2) / 2, 0.0});
-    for (size_t i = 1; i + 1 < path_filtered.size(); ++i) {
-        double angle = angle_between_points(path_filtered[i - 1], path_filtered[i], path_filtered[i + 1]);
-        turns.push_back(calculate_turning_properties(angle));
+turning_properties_t EnergyCalculator::get_path_turn(double angle, uint32_t &key) const {
+    // Quantised in the same way as in calculate_batch_path_energy, so that both give the same results
+    if (m_segment_cache) {
+        key = SegmentEnergyCache::angle_key(angle);
+        angle = key * SegmentEnergyCache::ANGLE_QUANTUM;
     }
-    turns.push_back({0, -config.average_acceleration, 0, 0, config.drone_mass * std::pow(v_r, 2) / 2, 0.0});
+    return get_turning_properties(angle);
+}
+
 
-    for (size_t i = 0; i + 1 < path_filtered.size(); ++i) {
-        total_energy += turns[i].energy;
-        auto energy = calculate_straight_line_energy_between_turns(turns[i], turns[i + 1],
-                                                                   distance_between_points(path_filtered[i],
-                                                                                           path_filtered[i + 1]));
-        total_energy += energy;
+energy_time_t EnergyCalculator::get_path_segment_energy(const turning_properties_t &turn1, uint32_t turn1_key,
+                                                        const turning_properties_t &turn2, uint32_t turn2_key,
+                                                        double length) const {
+    SegmentEnergyCache *cache = m_segment_cache.get();
+    if (!cache) {
+        return calculate_straight_line_energy_between_turns(turn1, turn2, length);
+    }
+    uint64_t length_key = SegmentEnergyCache::length_key(length);
+    energy_time_t segment;
+    if (!cache->find(turn1_key, turn2_key, length_key, segment.energy, segment.time)) {
+        segment = calculate_straight_line_energy_between_turns(
+                turn1, turn2, static_cast<double>(length_key) * SegmentEnergyCache::LENGTH_QUANTUM);
+        cache->insert(turn1_key, turn2_key, length_key, segment.energy, segment.time);
     }
-    return total_energy;
+    return segment;
 }
 
 
@@ -0,0 +1,84 @@
+#include "EnergyCalculatorCache.h"
+#include <algorithm>
+#include <functional>
+
+namespace {
+    void hash_combine(size_t &seed, double value) {
+        seed ^= std::hash<double>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+    bool same_config(const energy_calculator_config_t &c1, const energy_calculator_config_t &c2) {
+        const auto &b1 = c1.battery_model;
+        const auto &b2 = c2.battery_model;
+        const auto &s1 = c1.best_speed_model;
+        const auto &s2 = c2.best_speed_model;
+        return b1.cell_capacity == b2.cell_capacity && b1.number_of_cells == b2.number_of_cells &&
+               b1.d0 == b2.d0 && b1.d1 == b2.d1 && b1.d2 == b2.d2 && b1.d3 == b2.d3 &&
+               s1.c0 == s2.c0 && s1.c1 == s2.c1 && s1.c2 == s2.c2 &&
+               c1.drone_mass == c2.drone_mass && c1.drone_area == c2.drone_area &&
+               c1.average_acceleration == c2.average_acceleration && c1.propeller_radius == c2.propeller_radius &&
+               c1.number_of_propellers == c2.number_of_propellers &&
+               c1.allowed_path_deviation == c2.allowed_path_deviation;
+    }
+}
+
+EnergyCalculatorCache::EnergyCalculatorCache(size_t capacity, std::shared_ptr<loggers::SimpleLogger> logger,
+                                             size_t segment_cache_size) : m_capacity{std::max<size_t>(capacity, 1)},
+                                                                          m_logger{std::move(logger)},
+                                                                          m_segment_cache_size{segment_cache_size} {
+    m_entries.reserve(m_capacity);
+}
+
+size_t EnergyCalculatorCache::config_hash(const energy_calculator_config_t &config) {
+    size_t seed = 0;
+    for (double value: {config.battery_model.cell_capacity,
+                        static_cast<double>(config.battery_model.number_of_cells),
+                        config.battery_model.d0, config.battery_model.d1, config.battery_model.d2,
+                        config.battery_model.d3,
+                        config.best_speed_model.c0, config.best_speed_model.c1, config.best_speed_model.c2,
+                        config.drone_mass, config.drone_area, config.average_acceleration, config.propeller_radius,
+                        static_cast<double>(config.number_of_propellers), config.allowed_path_deviation}) {
+        hash_combine(seed, value);
+    }
+    return seed;
+}
+
+std::shared_ptr<const EnergyCalculator> EnergyCalculatorCache::get(const energy_calculator_config_t &config) {
+    size_t hash = config_hash(config);
+    std::scoped_lock lock(m_mutex);
+
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        if (m_entries[i].hash == hash && same_config(m_entries[i].config, config)) {
+            // Move the entry to the front
+            std::rotate(m_entries.begin(), m_entries.begin() + static_cast<long>(i),
+                        m_entries.begin() + static_cast<long>(i) + 1);
+            return m_entries.front().calculator;
+        }
+    }
+
+    auto calculator = create(config);
+    if (m_entries.size() == m_capacity) {
+        m_entries.pop_back();
+    }
+    m_entries.insert(m_entries.begin(), entry_t{hash, config, calculator});
+    return calculator;
+}
+
+std::shared_ptr<const EnergyCalculator> EnergyCalculatorCache::get_uncached(const energy_calculator_config_t &config) {
+    size_t hash = config_hash(config);
+    {
+        std::scoped_lock lock(m_mutex);
+        for (const auto &entry: m_entries) {
+            if (entry.hash == hash && same_config(entry.config, config)) {
+                return entry.calculator;
+            }
+        }
+    }
+    return create(config);
+}
+
+std::shared_ptr<EnergyCalculator> EnergyCalculatorCache::create(const energy_calculator_config_t &config) const {
+    auto calculator = std::make_shared<EnergyCalculator>(config, m_logger);
+    calculator->enable_segment_cache(m_segment_cache_size);
+    return calculator;
+}
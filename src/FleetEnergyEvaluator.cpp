@@ -0,0 +1,55 @@
+#include "FleetEnergyEvaluator.h"
+#include <cmath>
+
+FleetEnergyEvaluator::FleetEnergyEvaluator(std::vector<std::shared_ptr<const EnergyCalculator>> calculators)
+        : m_calculators{std::move(calculators)} {
+}
+
+std::vector<energy_time_t> FleetEnergyEvaluator::evaluate(const path_batch_t &batch) const {
+    std::vector<energy_time_t> res(m_calculators.size() * batch.n_paths, energy_time_t{0, 0});
+
+    std::vector<double> x, y, squared_length, length, angle;
+    for (size_t p = 0; p < batch.n_paths; ++p) {
+        // Filter the path by removing points in the same location as the previous one
+        x.clear();
+        y.clear();
+        for (size_t i = batch.offsets[p]; i < batch.offsets[p + 1]; ++i) {
+            double px = batch.x[i * batch.stride];
+            double py = batch.y[i * batch.stride];
+            if (x.empty() || px != x.back() || py != y.back()) {
+                x.push_back(px);
+                y.push_back(py);
+            }
+        }
+        if (x.size() < 2) {
+            continue;
+        }
+
+        size_t n_segments = x.size() - 1;
+        squared_length.resize(n_segments);
+        length.resize(n_segments);
+        angle.resize(n_segments);
+        for (size_t i = 0; i < n_segments; ++i) {
+            double dx = x[i + 1] - x[i];
+            double dy = y[i + 1] - y[i];
+            squared_length[i] = dx * dx + dy * dy;
+            length[i] = std::sqrt(squared_length[i]);
+        }
+        // The same as EnergyCalculator::angle_between_points, but with known lengths of the adjacent segments
+        angle[0] = 0;
+        for (size_t i = 1; i < n_segments; ++i) {
+            double dx = x[i + 1] - x[i - 1];
+            double dy = y[i + 1] - y[i - 1];
+            double cos_angle = (squared_length[i - 1] + squared_length[i] - (dx * dx + dy * dy)) /
+                               std::sqrt(4 * squared_length[i - 1] * squared_length[i]);
+            angle[i] = (cos_angle < -1 || cos_angle > 1) ? 0 : std::acos(cos_angle);
+        }
+
+        for (size_t c = 0; c < m_calculators.size(); ++c) {
+            res[c * batch.n_paths + p] = m_calculators[c]->calculate_path_energy_from_geometry(length.data(),
+                                                                                              angle.data(),
+                                                                                              n_segments);
+        }
+    }
+    return res;
+}
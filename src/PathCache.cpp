@@ -0,0 +1,107 @@
+#include "PathCache.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+PathCache::PathCache(size_t capacity, double quantum) : m_shard_capacity{(capacity + N_SHARDS - 1) / N_SHARDS},
+                                                        m_quantum{quantum} {
+}
+
+size_t PathCache::key_hash_t::operator()(const key_t &key) const {
+    uint64_t hash = 0;
+    for (int64_t coordinate: key.coordinates) {
+        hash = hash_mix(hash ^ static_cast<uint64_t>(coordinate));
+    }
+    return static_cast<size_t>(hash);
+}
+
+std::pair<int64_t, int64_t> PathCache::quantize(point_t p) const {
+    if (m_quantum > 0) {
+        return {std::llround(p.first / m_quantum), std::llround(p.second / m_quantum)};
+    }
+    // Exact comparison. Adding 0.0 turns -0.0 into 0.0, so that equal coordinates have equal bits
+    std::pair<int64_t, int64_t> res;
+    double x = p.first + 0.0, y = p.second + 0.0;
+    std::memcpy(&res.first, &x, sizeof(x));
+    std::memcpy(&res.second, &y, sizeof(y));
+    return res;
+}
+
+PathCache::key_t PathCache::make_key(point_t from, point_t to, bool &reversed) const {
+    auto q_from = quantize(from), q_to = quantize(to);
+    reversed = q_to < q_from;
+    if (reversed) {
+        std::swap(q_from, q_to);
+    }
+    return {{q_from.first, q_from.second, q_to.first, q_to.second}};
+}
+
+std::optional<std::vector<point_t>> PathCache::find(point_t from, point_t to) const {
+    if (m_shard_capacity == 0) {
+        return std::nullopt;
+    }
+    bool reversed;
+    key_t key = make_key(from, to, reversed);
+    size_t hash = key_hash_t{}(key);
+    shard_t &shard = m_shards[(hash >> 32) % N_SHARDS];
+
+    std::vector<point_t> path;
+    {
+        std::scoped_lock lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            return std::nullopt;
+        }
+        auto &entry = shard.entries[it->second];
+        entry.referenced = true;
+        path = entry.path;
+    }
+
+    if (reversed) {
+        std::reverse(path.begin(), path.end());
+    }
+    // With quantized keys, the stored path may start or end slightly apart from the requested points
+    path.front() = from;
+    path.back() = to;
+    return path;
+}
+
+void PathCache::insert(const std::vector<point_t> &path) {
+    if (m_shard_capacity == 0 || path.size() < 2) {
+        return;
+    }
+    bool reversed;
+    key_t key = make_key(path.front(), path.back(), reversed);
+    size_t hash = key_hash_t{}(key);
+    shard_t &shard = m_shards[(hash >> 32) % N_SHARDS];
+
+    // Paths are stored in the direction of their keys
+    std::vector<point_t> stored_path = path;
+    if (reversed) {
+        std::reverse(stored_path.begin(), stored_path.end());
+    }
+
+    std::scoped_lock lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.entries[it->second].path = std::move(stored_path);
+        shard.entries[it->second].referenced = true;
+        return;
+    }
+    if (shard.entries.size() < m_shard_capacity) {
+        shard.index.emplace(key, shard.entries.size());
+        shard.entries.push_back({key, std::move(stored_path), false});
+        return;
+    }
+
+    // CLOCK eviction: give a second chance to the entries found since the hand passed them last time
+    while (shard.entries[shard.clock_hand].referenced) {
+        shard.entries[shard.clock_hand].referenced = false;
+        shard.clock_hand = (shard.clock_hand + 1) % shard.entries.size();
+    }
+    shard.index.erase(shard.entries[shard.clock_hand].key);
+    shard.index.emplace(key, shard.clock_hand);
+    shard.entries[shard.clock_hand] = {key, std::move(stored_path), false};
+    shard.clock_hand = (shard.clock_hand + 1) % shard.entries.size();
+}
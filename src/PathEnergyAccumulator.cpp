@@ -0,0 +1,57 @@
+#include "PathEnergyAccumulator.h"
+#include "utils.hpp"
+
+PathEnergyAccumulator::PathEnergyAccumulator(EnergyCalculator energy_calculator) : m_energy_calculator(
+        std::move(energy_calculator)) {}
+
+void PathEnergyAccumulator::push_back(point_t point) {
+    if (m_states.empty()) {
+        m_states.push_back({point, point, m_energy_calculator.get_start_turn(), SegmentEnergyCache::START_TURN_KEY,
+                            {0, 0}, {0, 0}, 1});
+        return;
+    }
+
+    state_t state = m_states.back();
+    // Repeated points do not change the path
+    if (point == state.last_point) {
+        m_states.push_back(state);
+        return;
+    }
+
+    if (state.n_points > 1) {
+        // The turn at the last point is known now, so the segment before it can be finished
+        uint32_t turn_key = 0;
+        auto turn = m_energy_calculator.get_path_turn(
+                EnergyCalculator::angle_between_points(state.previous_point, state.last_point, point), turn_key);
+        state.committed.energy += state.previous_turn.energy;
+        state.committed += m_energy_calculator.get_path_segment_energy(
+                state.previous_turn, state.previous_turn_key, turn, turn_key,
+                distance_between_points(state.previous_point, state.last_point));
+        state.previous_turn = turn;
+        state.previous_turn_key = turn_key;
+    }
+
+    state.previous_point = state.last_point;
+    state.last_point = point;
+    state.n_points++;
+
+    state.total = state.committed;
+    state.total.energy += state.previous_turn.energy;
+    state.total += m_energy_calculator.get_path_segment_energy(
+            state.previous_turn, state.previous_turn_key, m_energy_calculator.get_stop_turn(),
+            SegmentEnergyCache::STOP_TURN_KEY, distance_between_points(state.previous_point, state.last_point));
+    m_states.push_back(state);
+}
+
+void PathEnergyAccumulator::pop_back() {
+    if (!m_states.empty()) {
+        m_states.pop_back();
+    }
+}
+
+energy_time_t PathEnergyAccumulator::energy_and_time() const {
+    if (m_states.empty()) {
+        return {0, 0};
+    }
+    return m_states.back().total;
+}
@@ -0,0 +1,101 @@
+#include "PathEnergyIndex.h"
+#include "utils.hpp"
+#include <stdexcept>
+
+PathEnergyIndex::PathEnergyIndex(const EnergyCalculator &energy_calculator, const std::vector<point_t> &path) {
+    m_filtered_index.reserve(path.size());
+    std::vector<point_t> filtered;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (filtered.empty() || path[i] != filtered.back()) {
+            filtered.push_back(path[i]);
+            m_original_index.push_back(i);
+        }
+        m_filtered_index.push_back(filtered.size() - 1);
+    }
+    if (filtered.size() < 2) {
+        return;
+    }
+
+    const auto start_turn = energy_calculator.get_start_turn();
+    const auto stop_turn = energy_calculator.get_stop_turn();
+    size_t n_segments = filtered.size() - 1;
+    m_start_segment.reserve(n_segments);
+    m_end_segment.reserve(n_segments);
+    m_single_segment.reserve(n_segments);
+    m_inner_prefix.reserve(filtered.size());
+    m_inner_prefix.push_back({0, 0});
+
+    // The segments are evaluated through the segment cache of the calculator, as in the whole path energy functions
+    const uint32_t START_KEY = SegmentEnergyCache::START_TURN_KEY, STOP_KEY = SegmentEnergyCache::STOP_TURN_KEY;
+    auto segment = [&](const turning_properties_t &turn1, uint32_t turn1_key, const turning_properties_t &turn2,
+                       uint32_t turn2_key, double length) {
+        return energy_time_t{turn1.energy, 0} +
+               energy_calculator.get_path_segment_energy(turn1, turn1_key, turn2, turn2_key, length);
+    };
+
+    // Turn at the start of the current segment. Not used for the first segment, as it always starts from hover
+    turning_properties_t turn = start_turn;
+    uint32_t turn_key = START_KEY;
+    for (size_t k = 0; k < n_segments; ++k) {
+        double length = distance_between_points(filtered[k], filtered[k + 1]);
+        bool last_segment = k + 1 == n_segments;
+        // Terms that do not exist in any valid range are set to 0
+        auto next_turn = stop_turn;
+        uint32_t next_turn_key = STOP_KEY;
+        if (!last_segment) {
+            next_turn = energy_calculator.get_path_turn(
+                    EnergyCalculator::angle_between_points(filtered[k], filtered[k + 1], filtered[k + 2]),
+                    next_turn_key);
+        }
+
+        m_single_segment.push_back(segment(start_turn, START_KEY, stop_turn, STOP_KEY, length));
+        m_start_segment.push_back(last_segment ? energy_time_t{0, 0}
+                                               : segment(start_turn, START_KEY, next_turn, next_turn_key, length));
+        m_end_segment.push_back(k == 0 ? energy_time_t{0, 0} : segment(turn, turn_key, stop_turn, STOP_KEY, length));
+        if (k > 0 && !last_segment) {
+            m_inner_prefix.push_back(m_inner_prefix.back() + segment(turn, turn_key, next_turn, next_turn_key, length));
+        }
+        turn = next_turn;
+        turn_key = next_turn_key;
+    }
+}
+
+energy_time_t PathEnergyIndex::range(size_t from, size_t to) const {
+    if (from > to || to >= size()) {
+        throw std::out_of_range("Invalid range of a path: " + std::to_string(from) + ", " + std::to_string(to));
+    }
+    return filtered_range(m_filtered_index[from], m_filtered_index[to]);
+}
+
+energy_time_t PathEnergyIndex::filtered_range(size_t from, size_t to) const {
+    if (from == to) {
+        return {0, 0};
+    }
+    if (to == from + 1) {
+        return m_single_segment[from];
+    }
+    // m_inner_prefix[k] contains the segments 1..k, so segments from + 1 .. to - 2 are taken
+    energy_time_t inner = m_inner_prefix[to - 2];
+    inner.energy -= m_inner_prefix[from].energy;
+    inner.time -= m_inner_prefix[from].time;
+    return m_start_segment[from] + inner + m_end_segment[to - 1];
+}
+
+size_t PathEnergyIndex::find_energy_limit(size_t from, double energy_limit) const {
+    if (from >= size()) {
+        throw std::out_of_range("Invalid start of a path: " + std::to_string(from));
+    }
+    size_t filtered_from = m_filtered_index[from];
+    // Binary search for the first filtered point at which the limit is exceeded
+    size_t lo = filtered_from + 1;
+    size_t hi = m_original_index.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (filtered_range(filtered_from, mid).energy > energy_limit) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo == m_original_index.size() ? size() : m_original_index[lo];
+}
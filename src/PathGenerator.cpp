@@ -7,6 +7,8 @@
 #include <std_msgs/String.h>
 #include "MapPolygon.hpp"
 #include "EnergyCalculator.h"
+#include "FleetEnergyEvaluator.h"
+#include "EnergyCalculatorCache.h"
 #include "algorithms.hpp"
 #include <boost/shared_ptr.hpp>
 #include <vector>
@@ -16,9 +18,112 @@
 #include "mstsp_solver/MstspSolver.h"
 #include <thesis_path_generator/GeneratePaths.h>
 #include <thesis_path_generator/CalculateEnergy.h>
+#include <thesis_path_generator/CalculateFleetEnergy.h>
+#include <thesis_path_generator/CalculateEnergyCompact.h>
 #include "LoggerRos.h"
 #include <mrs_msgs/Path.h>
 
+namespace {
+    template<typename P>
+    bool same_polygon(const P &p1, const P &p2) {
+        return p1.points.size() == p2.points.size() &&
+               std::equal(p1.points.begin(), p1.points.end(), p2.points.begin(),
+                          [](const auto &a, const auto &b) { return a.x == b.x && a.y == b.y; });
+    }
+
+    /*!
+     * Check if two requests describe the same problem except of the starting point and altitudes,
+     * so the decomposition, targets and their assignment for one of them can be reused for another one
+     */
+    bool same_field_request(const thesis_path_generator::GeneratePaths::Request &r1,
+                            const thesis_path_generator::GeneratePaths::Request &r2) {
+        if (!same_polygon(r1.fly_zone, r2.fly_zone) || r1.no_fly_zones.size() != r2.no_fly_zones.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < r1.no_fly_zones.size(); ++i) {
+            if (!same_polygon(r1.no_fly_zones[i], r2.no_fly_zones[i])) {
+                return false;
+            }
+        }
+        if (r1.override_battery_model != r2.override_battery_model ||
+            (r1.override_battery_model && (r1.battery_cell_capacity != r2.battery_cell_capacity ||
+                                           r1.battery_number_of_cells != r2.battery_number_of_cells))) {
+            return false;
+        }
+        if (r1.override_drone_parameters != r2.override_drone_parameters ||
+            (r1.override_drone_parameters && (r1.drone_mass != r2.drone_mass ||
+                                              r1.drone_area != r2.drone_area ||
+                                              r1.average_acceleration != r2.average_acceleration ||
+                                              r1.propeller_radius != r2.propeller_radius ||
+                                              r1.number_of_propellers != r2.number_of_propellers))) {
+            return false;
+        }
+        return r1.number_of_drones == r2.number_of_drones &&
+               r1.sweeping_step == r2.sweeping_step &&
+               r1.decomposition_method == r2.decomposition_method &&
+               r1.min_sub_polygons_per_uav == r2.min_sub_polygons_per_uav &&
+               r1.decomposition_rotation == r2.decomposition_rotation &&
+               r1.max_polygon_area == r2.max_polygon_area &&
+               r1.wall_distance == r2.wall_distance &&
+               r1.rotations_per_cell == r2.rotations_per_cell &&
+               r1.no_improvement_cycles_before_stop == r2.no_improvement_cycles_before_stop &&
+               r1.initial_solution_regret == r2.initial_solution_regret &&
+               r1.max_single_path_energy == r2.max_single_path_energy;
+    }
+
+    /*!
+     * Override the UAV and battery parameters of the config
+     */
+    void apply_drone_parameters(energy_calculator_config_t &config,
+                                const thesis_path_generator::DroneParameters &parameters) {
+        config.drone_mass = parameters.drone_mass;
+        config.drone_area = parameters.drone_area;
+        config.number_of_propellers = parameters.number_of_propellers;
+        config.propeller_radius = parameters.propeller_radius;
+        config.average_acceleration = parameters.average_acceleration;
+        config.battery_model.cell_capacity = parameters.battery_cell_capacity;
+        config.battery_model.number_of_cells = parameters.battery_number_of_cells;
+    }
+
+    /*!
+     * Offsets of the paths in one batch of all their points
+     * @param paths Paths from a request
+     * @return Offset of each path with the total number of points at the end
+     */
+    std::vector<uint32_t> path_offsets(const std::vector<nav_msgs::Path> &paths) {
+        std::vector<uint32_t> offsets;
+        offsets.reserve(paths.size() + 1);
+        offsets.push_back(0);
+        for (const auto &path: paths) {
+            offsets.push_back(offsets.back() + static_cast<uint32_t>(path.poses.size()));
+        }
+        return offsets;
+    }
+
+    /*!
+     * Write the metric coordinates of the path points
+     * @param path Path in a metric frame or in the "latlon_origin" frame
+     * @param x Output x coordinates of path.poses.size() points
+     * @param y Output y coordinates of path.poses.size() points
+     */
+    void convert_path(const nav_msgs::Path &path, double *x, double *y) {
+        if (path.poses.empty()) {
+            return;
+        }
+        // If path is in lat_lon origin frame, convert it to metric coordinates relative to its last point
+        bool latlon = path.header.frame_id == "latlon_origin";
+        point_t origin{path.poses.back().pose.position.x, path.poses.back().pose.position.y};
+        for (size_t i = 0; i < path.poses.size(); ++i) {
+            point_t p{path.poses[i].pose.position.x, path.poses[i].pose.position.y};
+            if (latlon) {
+                p = gps_coordinates_to_meters(p, origin);
+            }
+            x[i] = p.first;
+            y[i] = p.second;
+        }
+    }
+}
+
 namespace path_generation {
 
 /* onInit() method //{ */
@@ -55,6 +160,11 @@ namespace path_generation {
         pl.loadParam("number_of_propellers", m_energy_config.number_of_propellers);
         pl.loadParam("allowed_path_deviation", m_energy_config.allowed_path_deviation);
         pl.loadParam("number_of_rotations", m_number_of_rotations);
+        pl.loadParam("replan_no_improvement_cycles", m_replan_no_improvement_cycles);
+        pl.loadParam("segment_energy_cache_size", m_segment_energy_cache_size);
+        pl.loadParam("worker_threads", m_worker_threads);
+        pl.loadParam("shortest_paths_directory", m_shortest_paths_directory);
+        pl.loadParam("warm_up_shortest_paths", m_warm_up_shortest_paths);
 
 
         if (!pl.loadedSuccessfully()) {
@@ -64,18 +174,37 @@ namespace path_generation {
         } else {
             ROS_INFO_ONCE("[PathGenerator]: loaded parameters");
         }
+
+        m_shared_logger = std::make_shared<loggers::RosLogger>();
+        m_shared_logger->set_log_level(loggers::LOG_DEBUG);
+
+        m_thread_pool = std::make_unique<ThreadPool>(static_cast<size_t>(std::max(m_worker_threads, 0)));
+
+        m_energy_calculators = std::make_unique<EnergyCalculatorCache>(
+                ENERGY_CALCULATOR_CACHE_SIZE, m_shared_logger,
+                static_cast<size_t>(std::max(m_segment_energy_cache_size, 0)));
+
+        m_shortest_path_store = std::make_unique<ShortestPathStore>(m_shortest_paths_directory, m_shared_logger);
+        if (m_warm_up_shortest_paths) {
+            size_t n_files = m_shortest_path_store->warm_up();
+            ROS_INFO("[PathGenerator]: Reading ahead %zu files with the shortest paths of fields", n_files);
+        }
+
         m_calculate_energy_service_server = nh.advertiseService("/calculate_energy",
                                                                 &PathGenerator::callback_calculate_energy, this);
 
+        m_calculate_energy_compact_service_server = nh.advertiseService(
+                "/calculate_energy_compact", &PathGenerator::callback_calculate_energy_compact, this);
+
+        m_calculate_fleet_energy_service_server = nh.advertiseService("/calculate_fleet_energy",
+                                                                      &PathGenerator::callback_calculate_fleet_energy,
+                                                                      this);
+
         m_generate_paths_service_server = nh.advertiseService("/generate_paths",
                                                               &PathGenerator::callback_generate_paths, this);
         m_path_publisher = nh.advertise<mrs_msgs::Path>("path_generation/generated_path", 100);
 
 
-        m_shared_logger = std::make_shared<loggers::RosLogger>();
-        m_shared_logger->set_log_level(loggers::LOG_DEBUG);
-
-
         ROS_INFO_ONCE("[PathGenerator]: initialized");
 
         m_is_initialized = true;
@@ -102,30 +231,165 @@ namespace path_generation {
             energy_config.propeller_radius = req.propeller_radius;
             energy_config.average_acceleration = req.average_acceleration;
         }
-        EnergyCalculator calculator{energy_config, m_shared_logger};
+        auto calculator = m_energy_calculators->get(energy_config);
 
         res.success = true;
         try {
+            auto offsets = path_offsets(req.paths);
+            std::vector<double> xs(offsets.back()), ys(offsets.back());
+            res.energies.assign(req.paths.size(), 0.0);
+
+            // Each path is converted and evaluated by one of the workers
+            m_thread_pool->parallel_for(req.paths.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    convert_path(req.paths[i], xs.data() + offsets[i], ys.data() + offsets[i]);
+                }
+                energy_time_t energies[16];
+                for (size_t i = begin; i < end; i += 16) {
+                    size_t n = std::min<size_t>(16, end - i);
+                    calculator->calculate_path_energy_batch({xs.data(), ys.data(), 1, offsets.data() + i, n}, energies);
+                    for (size_t j = 0; j < n; ++j) {
+                        res.energies[i + j] = energies[j].energy;
+                    }
+                }
+            });
+        } catch (const std::runtime_error &e) {
+            ROS_ERROR_STREAM("[PathGenerator]: " << e.what());
             res.energies.clear();
-            for (const auto &req_path: req.paths) {
-                vpdd path;
-                path.reserve(req_path.poses.size());
-                for (const auto &p: req_path.poses) {
-                    path.emplace_back(p.pose.position.x, p.pose.position.y);
+            res.message = e.what();
+            res.success = false;
+        }
+        return true;
+    }
+
+
+    bool PathGenerator::callback_calculate_energy_compact(thesis_path_generator::CalculateEnergyCompact::Request &req,
+                                                          thesis_path_generator::CalculateEnergyCompact::Response &res) {
+        ROS_INFO_ONCE("[PathGenerator]: Compact path energy calculation service called");
+        if (!m_is_initialized) {
+            return false;
+        }
+
+        auto energy_config = m_energy_config;
+        if (req.allowed_path_deviation != 0) {
+            energy_config.allowed_path_deviation = req.allowed_path_deviation;
+        }
+        if (req.override_drone_parameters) {
+            apply_drone_parameters(energy_config, req.drone_parameters);
+        }
+        auto calculator = m_energy_calculators->get(energy_config);
+
+        bool single_precision = !req.coordinates_f32.empty();
+        size_t n_coordinates = single_precision ? req.coordinates_f32.size() : req.coordinates.size();
+        const auto &offsets = req.offsets;
+        bool valid_offsets = !offsets.empty() && offsets.front() == 0 &&
+                             static_cast<size_t>(offsets.back()) * 2 == n_coordinates &&
+                             std::is_sorted(offsets.begin(), offsets.end());
+        if ((single_precision && !req.coordinates.empty()) || !valid_offsets) {
+            res.success = false;
+            res.message = "Inconsistent coordinates and offsets of the paths";
+            ROS_ERROR_STREAM("[PathGenerator]: " << res.message);
+            return true;
+        }
+        size_t n_paths = offsets.size() - 1;
+        res.energies.assign(n_paths, 0.0);
+
+        // Metric coordinates are read in place, while geographic ones are converted to meters into a new array
+        std::vector<double> converted;
+        if (req.latlon) {
+            converted.resize(n_coordinates);
+            m_thread_pool->parallel_for(n_paths, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    if (offsets[i] == offsets[i + 1]) {
+                        continue;
+                    }
+                    auto coordinate = [&](size_t j) {
+                        return single_precision ? static_cast<double>(req.coordinates_f32[j]) : req.coordinates[j];
+                    };
+                    point_t origin{coordinate(2 * offsets[i + 1] - 2), coordinate(2 * offsets[i + 1] - 1)};
+                    for (size_t j = offsets[i]; j < offsets[i + 1]; ++j) {
+                        auto p = gps_coordinates_to_meters({coordinate(2 * j), coordinate(2 * j + 1)}, origin);
+                        converted[2 * j] = p.first;
+                        converted[2 * j + 1] = p.second;
+                    }
                 }
+            });
+        }
 
-                // If path is in lat_lon origin frame, convert it to metric coordinates
-                if (req_path.header.frame_id == "latlon_origin") {
-                    std::for_each(path.begin(), path.end(),
-                                  [&](auto &p) { p = gps_coordinates_to_meters(p, path[path.size() - 1]);});
+        res.success = true;
+        try {
+            m_thread_pool->parallel_for(n_paths, [&](size_t begin, size_t end) {
+                energy_time_t energies[16];
+                for (size_t i = begin; i < end; i += 16) {
+                    size_t n = std::min<size_t>(16, end - i);
+                    if (req.latlon) {
+                        calculator->calculate_path_energy_batch(
+                                path_batch_t{converted.data(), converted.data() + 1, 2, offsets.data() + i, n}, energies);
+                    } else if (single_precision) {
+                        const float *data = req.coordinates_f32.data();
+                        calculator->calculate_path_energy_batch(
+                                path_batch_f32_t{data, data + 1, 2, offsets.data() + i, n}, energies);
+                    } else {
+                        const double *data = req.coordinates.data();
+                        calculator->calculate_path_energy_batch(
+                                path_batch_t{data, data + 1, 2, offsets.data() + i, n}, energies);
+                    }
+                    for (size_t j = 0; j < n; ++j) {
+                        res.energies[i + j] = energies[j].energy;
+                    }
                 }
+            });
+        } catch (const std::runtime_error &e) {
+            ROS_ERROR_STREAM("[PathGenerator]: " << e.what());
+            res.energies.clear();
+            res.message = e.what();
+            res.success = false;
+        }
+        return true;
+    }
 
-                auto energy = calculator.calculate_path_energy_consumption(path);
-                res.energies.push_back(energy);
+
+    bool PathGenerator::callback_calculate_fleet_energy(thesis_path_generator::CalculateFleetEnergy::Request &req,
+                                                        thesis_path_generator::CalculateFleetEnergy::Response &res) {
+        ROS_INFO_ONCE("[PathGenerator]: Fleet energy calculation service called");
+        if (!m_is_initialized) {
+            return false;
+        }
+
+        // The calculators of CalculateEnergy are reused if they are cached. Other variants get calculators with the
+        // same settings that are not stored, so that a sweep over many variants does not evict the ones in use
+        std::vector<std::shared_ptr<const EnergyCalculator>> calculators;
+        for (const auto &variant: req.variants) {
+            auto energy_config = m_energy_config;
+            if (req.allowed_path_deviation != 0) {
+                energy_config.allowed_path_deviation = req.allowed_path_deviation;
+            }
+            apply_drone_parameters(energy_config, variant);
+            calculators.push_back(m_energy_calculators->get_uncached(energy_config));
+        }
+
+        res.success = true;
+        try {
+            auto offsets = path_offsets(req.paths);
+            std::vector<double> xs(offsets.back()), ys(offsets.back());
+            m_thread_pool->parallel_for(req.paths.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    convert_path(req.paths[i], xs.data() + offsets[i], ys.data() + offsets[i]);
+                }
+            });
+
+            FleetEnergyEvaluator evaluator{std::move(calculators)};
+            auto results = evaluator.evaluate({xs.data(), ys.data(), 1, offsets.data(), req.paths.size()});
+            res.energies.clear();
+            res.times.clear();
+            for (const auto &r: results) {
+                res.energies.push_back(r.energy);
+                res.times.push_back(r.time);
             }
         } catch (const std::runtime_error &e) {
             ROS_ERROR_STREAM("[PathGenerator]: " << e.what());
             res.energies.clear();
+            res.times.clear();
             res.message = e.what();
             res.success = false;
         }
@@ -142,9 +406,6 @@ namespace path_generation {
             res.message = "Fly zone of less than 3 points";
             return true;
         }
-        m_drones_altitude = req.drones_altitude;
-        m_unique_altitude_step = req.unique_altitude_step;
-
         point_t gps_transform_origin{req.fly_zone.points.front().x, req.fly_zone.points.front().y};
 
         // Convert the area from message to custom MapPolygon type
@@ -165,14 +426,11 @@ namespace path_generation {
             energy_config.propeller_radius = req.propeller_radius;
         }
 
-        // Create the energy calculator from user-defines parameters
-        EnergyCalculator energy_calculator{energy_config};
-        energy_calculator.set_logger(m_shared_logger);
+        // Get the energy calculator for user-defines parameters
+        auto energy_calculator_ptr = m_energy_calculators->get(energy_config);
+        const EnergyCalculator &energy_calculator = *energy_calculator_ptr;
         ROS_INFO_STREAM("[PathGenerator]: Optimal speed: " << energy_calculator.get_optimal_speed());
 
-        // Decompose the polygon
-        ShortestPathCalculator shortest_path_calculator(polygon);
-
         if (req.decomposition_method >= static_cast<uint8_t>(DECOMPOSITION_TYPES_NUMBER)) {
             ROS_ERROR_STREAM("[PathGenerator]: Wrong decomposition method chosen");
             res.message = "Wrong decomposition method";
@@ -181,21 +439,39 @@ namespace path_generation {
 
 
         mstsp_solver::final_solution_t best_solution;
-        try {
-            auto f = [&](int n) {
-                return solve_for_uavs(n, req, polygon, energy_calculator, shortest_path_calculator,
-                                      gps_transform_origin);
-            };
-            best_solution = generate_with_constraints(req.max_single_path_energy * 3600, req.number_of_drones, f);
-        } catch (const polygon_decomposition_error &e) {
-            ROS_ERROR("[PathGenerator]: Error while decomposing the polygon");
-            res.success = false;
-            res.message = "Error while decomposing the polygon";
-            return true;
-        } catch (const std::runtime_error &e) {
-            ROS_ERROR_STREAM("[PathGenerator]: Error while solving for polygons: " << e.what());
-            res.success = false;
-            return true;
+        if (replan_cached(req, gps_transform_origin, best_solution)) {
+            ROS_INFO("[PathGenerator]: Only the starting point or altitudes changed. Re-planned the cached solution");
+        } else {
+            // Decompose the polygon
+            ShortestPathCalculator shortest_path_calculator = m_shortest_path_store->get(polygon, m_thread_pool.get());
+
+            std::shared_ptr<mstsp_solver::MstspSolver> best_solver;
+            try {
+                auto f = [&](int n) {
+                    return solve_for_uavs(n, req, polygon, energy_calculator, shortest_path_calculator,
+                                          gps_transform_origin, best_solver);
+                };
+                best_solution = generate_with_constraints(req.max_single_path_energy * 3600, req.number_of_drones, f);
+            } catch (const polygon_decomposition_error &e) {
+                ROS_ERROR("[PathGenerator]: Error while decomposing the polygon");
+                res.success = false;
+                res.message = "Error while decomposing the polygon";
+                return true;
+            } catch (const std::runtime_error &e) {
+                ROS_ERROR_STREAM("[PathGenerator]: Error while solving for polygons: " << e.what());
+                res.success = false;
+                return true;
+            }
+
+            std::scoped_lock lock(m_replan_cache_mutex);
+            if (best_solver) {
+                m_cached_request = req;
+                m_cached_solver = best_solver;
+                m_cached_solution = best_solution.solution;
+            } else {
+                m_cached_request.reset();
+                m_cached_solver.reset();
+            }
         }
         auto best_paths = best_solution.paths;
 
@@ -226,6 +502,50 @@ namespace path_generation {
         return true;
     }
 
+    bool PathGenerator::replan_cached(const thesis_path_generator::GeneratePaths::Request &req,
+                                      std::pair<double, double> gps_transform_origin,
+                                      mstsp_solver::final_solution_t &solution) {
+        // Re-plan a copy of the cached solver, so that the lock is not held during the search and the cache is not
+        // changed by a re-planning that is rejected below
+        std::shared_ptr<mstsp_solver::MstspSolver> cached_solver;
+        mstsp_solver::_instance_solution_t previous_solution;
+        {
+            std::scoped_lock lock(m_replan_cache_mutex);
+            if (!m_cached_solver || !m_cached_request.has_value() ||
+                !same_field_request(req, m_cached_request.value())) {
+                return false;
+            }
+            cached_solver = m_cached_solver;
+            previous_solution = m_cached_solution;
+        }
+        auto solver = std::make_shared<mstsp_solver::MstspSolver>(*cached_solver);
+
+        auto starting_point = gps_coordinates_to_meters({req.start_lat, req.start_lon}, gps_transform_origin);
+        mstsp_solver::final_solution_t replanned;
+        try {
+            replanned = solver->replan(starting_point, req.drones_altitude, req.unique_altitude_step,
+                                       previous_solution, m_replan_no_improvement_cycles);
+        } catch (const std::runtime_error &e) {
+            ROS_WARN_STREAM("[PathGenerator]: Re-planning failed: " << e.what());
+            return false;
+        }
+
+        // With the new starting point, the energy constraint may need a different number of UAVs
+        if (replanned.max_path_energy > req.max_single_path_energy * 3600) {
+            return false;
+        }
+        {
+            // Publish only if another request has not replaced the cache in the meantime
+            std::scoped_lock lock(m_replan_cache_mutex);
+            if (m_cached_solver == cached_solver) {
+                m_cached_solver = solver;
+                m_cached_solution = replanned.solution;
+            }
+        }
+        solution = std::move(replanned);
+        return true;
+    }
+
     mrs_msgs::Path PathGenerator::_generate_path_for_simulation_one_drone(
             const std::vector<point_heading_t<double>> &points_to_visit,
             point_t gps_transform_origin,
@@ -282,7 +602,9 @@ namespace path_generation {
                                   MapPolygon polygon,
                                   const EnergyCalculator &energy_calculator,
                                   const ShortestPathCalculator &shortest_path_calculator,
-                                  std::pair<double, double> gps_transform_origin) {
+                                  std::pair<double, double> gps_transform_origin,
+                                  std::shared_ptr<mstsp_solver::MstspSolver> &best_solver) {
+        best_solver.reset();
         auto init_polygon = polygon;
         // TODO: make a parameter taken from message here as it directly influences the computation time
         auto best_initial_rotations = n_best_init_decomp_angles(polygon, m_number_of_rotations,
@@ -328,20 +650,23 @@ namespace path_generation {
             // Create the configuration for MSTSP solver
             auto starting_point = gps_coordinates_to_meters({req.start_lat, req.start_lon}, gps_transform_origin);
             mstsp_solver::SolverConfig solver_config{req.rotations_per_cell, req.sweeping_step, starting_point,
-                                                     static_cast<size_t>(n_uavs), m_drones_altitude,
-                                                     m_unique_altitude_step,
+                                                     static_cast<size_t>(n_uavs),
+                                                     static_cast<double>(req.drones_altitude),
+                                                     req.unique_altitude_step,
                                                      req.no_improvement_cycles_before_stop};
             solver_config.wall_distance = req.wall_distance;
-            mstsp_solver::MstspSolver solver(solver_config, polygons_decomposed, energy_calculator,
-                                             shortest_path_calculator);
-            solver.set_logger(m_shared_logger);
+            solver_config.initial_solution_regret = req.initial_solution_regret;
+            auto solver = std::make_shared<mstsp_solver::MstspSolver>(solver_config, polygons_decomposed,
+                                                                      energy_calculator, shortest_path_calculator);
+            solver->set_logger(m_shared_logger);
 
-            auto solver_res = solver.solve();
+            auto solver_res = solver->solve();
 
             // Change the best solution if the current one is better
             if (solver_res.max_path_energy < best_solution_cost) {
                 best_solution_cost = solver_res.max_path_energy;
                 best_solution = solver_res;
+                best_solver = solver;
                 ROS_INFO_STREAM("[PathGenerator]: best solution rotation: " << rotation / M_PI * 180 << std::endl);
             }
         }
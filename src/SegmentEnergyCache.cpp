@@ -0,0 +1,89 @@
+#include "SegmentEnergyCache.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+    uint64_t to_bits(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    double from_bits(uint64_t bits) {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint64_t pack_turns(uint32_t turn1, uint32_t turn2) {
+        return (static_cast<uint64_t>(turn1) << 32) | turn2;
+    }
+}
+
+SegmentEnergyCache::SegmentEnergyCache(size_t n_entries) {
+    size_t size = 1;
+    while (size < n_entries) {
+        size <<= 1;
+    }
+    m_entries = std::make_unique<entry_t[]>(size);
+    m_mask = size - 1;
+}
+
+uint32_t SegmentEnergyCache::angle_key(double angle) {
+    return static_cast<uint32_t>(std::lround(std::abs(angle) / ANGLE_QUANTUM));
+}
+
+uint64_t SegmentEnergyCache::length_key(double length) {
+    return static_cast<uint64_t>(std::llround(length / LENGTH_QUANTUM));
+}
+
+size_t SegmentEnergyCache::slot(uint64_t turns, uint64_t length) const {
+    uint64_t h = turns * 0x9E3779B97F4A7C15ULL;
+    h ^= length + 0x7F4A7C159E3779B9ULL + (h << 6) + (h >> 2);
+    h ^= h >> 31;
+    return static_cast<size_t>(h) & m_mask;
+}
+
+bool SegmentEnergyCache::find(uint32_t turn1, uint32_t turn2, uint64_t length, double &energy, double &time) const {
+    uint64_t turns = pack_turns(turn1, turn2);
+    const auto &entry = m_entries[slot(turns, length)];
+
+    uint32_t sequence = entry.sequence.load(std::memory_order_acquire);
+    if (sequence == 0 || sequence % 2 == 1) {
+        return false;
+    }
+    uint64_t entry_turns = entry.turns.load(std::memory_order_relaxed);
+    uint64_t entry_length = entry.length.load(std::memory_order_relaxed);
+    uint64_t energy_bits = entry.energy_bits.load(std::memory_order_relaxed);
+    uint64_t time_bits = entry.time_bits.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // The entry was overwritten while being read
+    if (entry.sequence.load(std::memory_order_relaxed) != sequence) {
+        return false;
+    }
+
+    if (entry_turns != turns || entry_length != length) {
+        return false;
+    }
+    energy = from_bits(energy_bits);
+    time = from_bits(time_bits);
+    return true;
+}
+
+void SegmentEnergyCache::insert(uint32_t turn1, uint32_t turn2, uint64_t length, double energy, double time) {
+    uint64_t turns = pack_turns(turn1, turn2);
+    auto &entry = m_entries[slot(turns, length)];
+
+    uint32_t sequence = entry.sequence.load(std::memory_order_relaxed);
+    if (sequence % 2 == 1 ||
+        !entry.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire)) {
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.turns.store(turns, std::memory_order_relaxed);
+    entry.length.store(length, std::memory_order_relaxed);
+    entry.energy_bits.store(to_bits(energy), std::memory_order_relaxed);
+    entry.time_bits.store(to_bits(time), std::memory_order_relaxed);
+    // Skip 0 on overflow as it marks an empty entry
+    entry.sequence.store(sequence + 2 == 0 ? 2 : sequence + 2, std::memory_order_release);
+}
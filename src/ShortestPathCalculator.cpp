@@ -1,177 +1,1099 @@
 #include "ShortestPathCalculator.hpp"
 #include <algorithm>
+#include <cstring>
+#include <set>
 #include "utils.hpp"
+#include "ThreadPool.h"
 #include <cmath>
+#include <functional>
+#include <queue>
+#include <string>
+#include <tuple>
 
 namespace {
     const double EPS = 1e-5;
+    // Side of a square tile of the Floyd-Warshall matrix. Three tiles of both matrices fit in L1 cache
+    const size_t FLOYD_WARSHALL_BLOCK = 32;
 
-    point_t pm(point_t point) {
-        return {point.first * 1000, point.second * 1000};
+    /*!
+     * Relax the shortest paths between the vertices of block bi and the vertices of block bj through the vertices of
+     * block bk. The inner loop is branchless, so the compiler vectorizes it when AVX2 is enabled (e.g. -march=native)
+     * @param d Row-major matrix of the shortest path lengths
+     * @param next Row-major matrix of the next vertices in the shortest paths
+     * @param n Number of vertices
+     */
+    void relax_tile(double *d, uint32_t *next, size_t n, size_t bi, size_t bj, size_t bk) {
+        const size_t i_end = std::min(n, (bi + 1) * FLOYD_WARSHALL_BLOCK);
+        const size_t j_begin = bj * FLOYD_WARSHALL_BLOCK, j_end = std::min(n, (bj + 1) * FLOYD_WARSHALL_BLOCK);
+        const size_t k_end = std::min(n, (bk + 1) * FLOYD_WARSHALL_BLOCK);
+        for (size_t k = bk * FLOYD_WARSHALL_BLOCK; k < k_end; ++k) {
+            const double *d_k = d + k * n;
+            for (size_t i = bi * FLOYD_WARSHALL_BLOCK; i < i_end; ++i) {
+                double *d_i = d + i * n;
+                uint32_t *next_i = next + i * n;
+                const double d_ik = d_i[k];
+                if (d_ik == HUGE_VAL) {
+                    continue;
+                }
+                // Now, to get to j from i, we should in direction to k (to next vertex in path to k)
+                const uint32_t next_ik = next_i[k];
+                for (size_t j = j_begin; j < j_end; ++j) {
+                    const double current = d_i[j], through_k = d_ik + d_k[j];
+                    d_i[j] = through_k < current ? through_k : current;
+                    next_i[j] = through_k < current ? next_ik : next_i[j];
+                }
+            }
+        }
+    }
+
+    /*!
+     * Number all the vertices of the polygon in the order of their coordinates
+     * @param all_points Output vertices
+     * @param all_point_index Output index of each vertex in all_points
+     */
+    void index_polygon_points(const MapPolygon &polygon, std::vector<point_t> &all_points,
+                              std::map<point_t, int> &all_point_index) {
+        auto points_tmp = polygon.get_all_points();
+        all_points.assign(points_tmp.begin(), points_tmp.end());
+        all_point_index.clear();
+        for (size_t i = 0; i < all_points.size(); ++i) {
+            all_point_index[all_points[i]] = static_cast<int>(i);
+        }
+    }
+
+    /*!
+     * Bounding box of the polygon as (min point, max point)
+     */
+    std::pair<point_t, point_t> bounding_box(const polygon_t &polygon) {
+        point_t min = polygon.front(), max = polygon.front();
+        for (const auto &p: polygon) {
+            min = {std::min(min.first, p.first), std::min(min.second, p.second)};
+            max = {std::max(max.first, p.first), std::max(max.second, p.second)};
+        }
+        return {min, max};
+    }
+
+    /*!
+     * Cross product of vectors (a - o) and (b - o). Positive if b is counterclockwise from a when looking from o
+     */
+    double cross(point_t o, point_t a, point_t b) {
+        return (a.first - o.first) * (b.second - o.second) - (a.second - o.second) * (b.first - o.first);
     }
 
     /*!
-     * Calculate the sets of polygon point pairs for which there is no direct path in a straight line.
-     *
-     * The set will include the pairs that can "see" each other through the center of the polygon for no-fly-zones
-     * e.g. all possible pairs for a convex polygon except of neighbouring ones
-     *
-     * For a fly-zone, the set will include points that can "see" each other from outside of the polygon
-     * e.g. if the polygon is concave, there is always a pair of points that can "see" each other without
-     * any segments between them, but the direct path goes outside of the fly-zone
-     *
-     * @param polygon Polygon as a set of vertices
-     * @param fly_zone Whether the polygon should be treated as a fly-zone
-     * @return Set of polygon vertices between which there is no direct path not leaving the fly-zone
+     * Neighbours of a vertex in one polygon ring. As all the rings are clockwise, the inside of the ring at the vertex
+     * is the wedge from the direction to the previous vertex counterclockwise to the direction to the next one
+     */
+    struct vertex_wedge_t {
+        size_t previous;
+        size_t next;
+        bool fly_zone;
+    };
+
+    /*!
+     * Visibility graph construction by the rotational plane sweep (Lee's algorithm).
+     * For each vertex, all the other vertices are sorted by angle around it and a ray is rotated through them, keeping
+     * the polygon edges intersected by the ray ordered by the distance from the vertex. The vertex is seen if the
+     * nearest intersected edge is not closer than it. This gives O(N^2 * log(N)) instead of checking each pair against
+     * each segment.
+     * Pairs of vertices, the segment between which leaves the fly-zone or enters a no-fly zone right at one of its
+     * ends (e.g. two vertices of a convex no-fly zone) are excluded by checking the direction against the polygon
+     * wedges at both of the vertices.
      */
-    std::set<segment_t> no_direct_path(const std::vector<point_t> &polygon, bool fly_zone = true) {
-
-        // Vector of turning angles around each polygon node
-        std::vector<double> angles;
-        angles.push_back(angle_between_vectors(pm(polygon[polygon.size() - 2]), pm(polygon[0]), pm(polygon[1])));
-        for (size_t i = 1; i + 1 < polygon.size(); ++i) {
-            angles.push_back(angle_between_vectors(pm(polygon[i - 1]), pm(polygon[i]), pm(polygon[i + 1])));
-        }
-
-
-        std::set<segment_t> no_direct_view;
-        // Iterate through each pair of points in the polygon and if the sum of angles between them is not suitable -
-        // add them to the list of not possible ones
-        for (size_t i = 0; i < angles.size(); ++i) {
-            double angle = 0;
-            for (size_t j = i + 2; j < angles.size(); j++) {
-                angle += M_PI - angles[j - 1];
-                if (((angle < 0 - EPS || angle > 2 * M_PI + EPS) && fly_zone) ||
-                    ((angle < 2 * M_PI - EPS && angle > 0 + EPS) && !fly_zone)) {
-                    no_direct_view.insert({polygon[i], polygon[j]});
+    class VisibilitySweep {
+    public:
+        VisibilitySweep(const std::vector<point_t> &points, const MapPolygon &polygon,
+                        const std::map<point_t, int> &point_index) : m_points{points},
+                                                                      m_incident_edges(points.size()),
+                                                                      m_wedges(points.size()) {
+            add_ring(polygon.fly_zone_polygon_points, point_index, true);
+            for (const auto &no_fly_zone: polygon.no_fly_zone_polygons) {
+                add_ring(no_fly_zone, point_index, false);
+            }
+        }
+
+        /*!
+         * Check whether the shortest paths can bend at the vertex. It is so only for concave fly-zone corners and
+         * convex no-fly zone corners (the free space angle is more than pi). Vertices shared by several polygon rings
+         * are always considered reflex
+         * @param vertex Index of the vertex
+         * @return true if the vertex is reflex
+         */
+        bool is_reflex(size_t vertex) const {
+            const auto &wedges = m_wedges[vertex];
+            if (wedges.size() != 1) {
+                return wedges.size() > 1;
+            }
+            const point_t &v = m_points[vertex];
+            double inner_angle = angle_between_vectors(m_points[wedges[0].previous], v, m_points[wedges[0].next]);
+            return wedges[0].fly_zone ? inner_angle > M_PI + EPS : inner_angle < M_PI - EPS;
+        }
+
+        /*!
+         * Find all the vertices that can be reached from the vertex in a straight line
+         * @param origin Index of the vertex
+         * @param targets Mask of the vertices that should be reported. All the vertices are still swept over as their
+         * edges can block the view
+         * @return Indices of the target vertices seen from the origin
+         */
+        std::vector<size_t> visible_from(size_t origin, const std::vector<bool> &targets) const {
+            const point_t o = m_points[origin];
+
+            std::vector<size_t> order;
+            order.reserve(m_points.size());
+            for (size_t i = 0; i < m_points.size(); ++i) {
+                if (i != origin) {
+                    order.push_back(i);
+                }
+            }
+            // Counterclockwise order starting from the direction of x axis. Points in the same direction - from the
+            // closest one. Cross products are used instead of atan2 to be consistent with the edge side checks below
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                const point_t &pa = m_points[a], &pb = m_points[b];
+                int half_a = pa.second < o.second || (pa.second == o.second && pa.first < o.first);
+                int half_b = pb.second < o.second || (pb.second == o.second && pb.first < o.first);
+                if (half_a != half_b) {
+                    return half_a < half_b;
+                }
+                double c = cross(o, pa, pb);
+                if (c != 0) {
+                    return c > 0;
+                }
+                return distance_between_points(o, pa) < distance_between_points(o, pb);
+            });
+
+            sweep_ray_t ray{o, {o.first + 1, o.second}};
+            status_t status{edge_order_t{this, &ray}};
+            std::vector<status_t::iterator> position(m_edges.size(), status.end());
+
+            // Initially, the ray intersects edges crossing the x axis to the right of the origin. Edges that only
+            // touch it from above will be added when their endpoint is reached
+            for (size_t e = 0; e < m_edges.size(); ++e) {
+                if (m_edges[e].first == origin || m_edges[e].second == origin) {
+                    continue;
+                }
+                const point_t &a = m_points[m_edges[e].first], &b = m_points[m_edges[e].second];
+                if (std::min(a.second, b.second) >= o.second || std::max(a.second, b.second) < o.second) {
+                    continue;
+                }
+                double x = a.first + (o.second - a.second) * (b.first - a.first) / (b.second - a.second);
+                if (x > o.first) {
+                    position[e] = status.insert(e).first;
                 }
             }
+
+            std::vector<size_t> visible;
+            bool previous_visible = false;
+            for (size_t k = 0; k < order.size(); ++k) {
+                const size_t w = order[k];
+                const point_t &pw = m_points[w];
+                ray.target = pw;
+
+                bool seen = direction_is_free(origin, pw) && direction_is_free(w, o);
+                if (seen) {
+                    const double distance = distance_between_points(o, pw);
+                    const point_t *previous = k > 0 ? &m_points[order[k - 1]] : nullptr;
+                    if (previous == nullptr || cross(o, *previous, pw) != 0 ||
+                        (previous->first - o.first) * (pw.first - o.first) +
+                        (previous->second - o.second) * (pw.second - o.second) <= 0) {
+                        seen = status.empty() || ray_distance(*status.begin(), ray) >= distance - EPS;
+                    } else {
+                        // The previous vertex lies on the way. The segment goes through it, so it should be seen
+                        // itself, the segment should not enter the polygon at it and no edge should lie between them
+                        const double previous_distance = distance_between_points(o, *previous);
+                        seen = previous_visible && direction_is_free(order[k - 1], pw);
+                        for (auto it = status.begin(); seen && it != status.end(); ++it) {
+                            double edge_distance = ray_distance(*it, ray);
+                            if (edge_distance <= previous_distance + EPS) {
+                                continue;
+                            }
+                            seen = edge_distance >= distance - EPS;
+                            break;
+                        }
+                    }
+                }
+                previous_visible = seen;
+                if (seen && targets[w]) {
+                    visible.push_back(w);
+                }
+
+                // Remove the edges that end at this vertex and add the ones starting in it
+                for (size_t e: m_incident_edges[w]) {
+                    size_t other = m_edges[e].first == w ? m_edges[e].second : m_edges[e].first;
+                    if (other != origin && position[e] != status.end() && cross(o, pw, m_points[other]) < 0) {
+                        status.erase(position[e]);
+                        position[e] = status.end();
+                    }
+                }
+                for (size_t e: m_incident_edges[w]) {
+                    size_t other = m_edges[e].first == w ? m_edges[e].second : m_edges[e].first;
+                    if (other != origin && position[e] == status.end() && cross(o, pw, m_points[other]) > 0) {
+                        position[e] = status.insert(e).first;
+                    }
+                }
+            }
+            return visible;
         }
-        // If first and last points were added accidentally, remove them
-        auto pos = no_direct_view.find({polygon.front(), polygon[polygon.size() - 2]});
-        if (pos != no_direct_view.end()) {
-            no_direct_view.erase(pos);
+
+        /*!
+         * Check whether two vertices see each other by the same rules as visible_from. Cheaper than the sweep when
+         * only a few pairs should be checked
+         * @param edge_grid Grid over edge_segments() of this sweep
+         */
+        bool vertex_sees_vertex(size_t a, size_t b, const SegmentGrid &edge_grid) const {
+            const point_t &pa = m_points[a], &pb = m_points[b];
+            if (!direction_is_free(a, pb) || !direction_is_free(b, pa)) {
+                return false;
+            }
+            const double length = distance_between_points(pa, pb);
+            // Side of the point relative to the line, with the points closer than EPS to it lying on it
+            auto side = [&](point_t from, point_t to, point_t p) {
+                double c = cross(from, to, p) / distance_between_points(from, to);
+                return c > EPS ? 1 : (c < -EPS ? -1 : 0);
+            };
+            return !edge_grid.any_segment_along({pa, pb}, [&](size_t e) {
+                const point_t &p1 = m_points[m_edges[e].first], &p2 = m_points[m_edges[e].second];
+                int side1 = side(pa, pb, p1), side2 = side(pa, pb, p2);
+                if (side1 * side2 < 0 && side(p1, p2, pa) * side(p1, p2, pb) < 0) {
+                    return true;
+                }
+                // A vertex on the segment blocks it unless the segment passes through it staying in the free space
+                for (size_t c: {m_edges[e].first, m_edges[e].second}) {
+                    const point_t &pc = m_points[c];
+                    double along = (pc.first - pa.first) * (pb.first - pa.first) +
+                                   (pc.second - pa.second) * (pb.second - pa.second);
+                    if (c != a && c != b && side(pa, pb, pc) == 0 && along > 0 && along < length * length &&
+                        (!direction_is_free(c, pa) || !direction_is_free(c, pb))) {
+                        return true;
+                    }
+                }
+                return false;
+            });
         }
-        return no_direct_view;
-    }
+
+        /*!
+         * @return Polygon edges as segments, in the order of their indices
+         */
+        std::vector<segment_t> edge_segments() const {
+            std::vector<segment_t> res;
+            res.reserve(m_edges.size());
+            for (const auto &[first, second]: m_edges) {
+                res.emplace_back(m_points[first], m_points[second]);
+            }
+            return res;
+        }
+
+    private:
+        struct sweep_ray_t {
+            point_t origin;
+            point_t target;
+        };
+
+        /*!
+         * Order of edges by the distance of their intersection with the current ray from the origin.
+         * As the edges do not cross each other, the order does not change while the ray rotates
+         */
+        struct edge_order_t {
+            const VisibilitySweep *sweep;
+            const sweep_ray_t *ray;
+
+            bool operator()(size_t e1, size_t e2) const {
+                if (e1 == e2) {
+                    return false;
+                }
+                double d1 = sweep->ray_distance(e1, *ray), d2 = sweep->ray_distance(e2, *ray);
+                if (std::abs(d1 - d2) > EPS) {
+                    return d1 < d2;
+                }
+                // Edges with a common vertex on the ray. The one closer to the origin makes the smaller angle with
+                // the direction from the common vertex to the origin
+                const auto &edges = sweep->m_edges;
+                size_t common;
+                if (edges[e1].first == edges[e2].first || edges[e1].first == edges[e2].second) {
+                    common = edges[e1].first;
+                } else if (edges[e1].second == edges[e2].first || edges[e1].second == edges[e2].second) {
+                    common = edges[e1].second;
+                } else {
+                    return d1 < d2 || (d1 == d2 && e1 < e2);
+                }
+                const auto &points = sweep->m_points;
+                size_t other1 = edges[e1].first == common ? edges[e1].second : edges[e1].first;
+                size_t other2 = edges[e2].first == common ? edges[e2].second : edges[e2].first;
+                return unsigned_angle(points[common], ray->origin, points[other1]) <
+                       unsigned_angle(points[common], ray->origin, points[other2]);
+            }
+        };
+
+        using status_t = std::set<size_t, edge_order_t>;
+
+        const std::vector<point_t> &m_points;
+        std::vector<std::pair<size_t, size_t>> m_edges;
+        std::vector<std::vector<size_t>> m_incident_edges;
+        std::vector<std::vector<vertex_wedge_t>> m_wedges;
+
+        static double unsigned_angle(point_t vertex, point_t a, point_t b) {
+            double c = cross(vertex, a, b);
+            double dot = (a.first - vertex.first) * (b.first - vertex.first) +
+                         (a.second - vertex.second) * (b.second - vertex.second);
+            return std::atan2(std::abs(c), dot);
+        }
+
+        void add_ring(const std::vector<point_t> &ring, const std::map<point_t, int> &point_index, bool fly_zone) {
+            size_t n = ring.size();
+            if (n > 1 && ring.front() == ring.back()) {
+                --n;
+            }
+            if (n < 3) {
+                return;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                size_t current = point_index.at(ring[i]);
+                size_t next = point_index.at(ring[(i + 1) % n]);
+                size_t previous = point_index.at(ring[(i + n - 1) % n]);
+                m_wedges[current].push_back({previous, next, fly_zone});
+                if (current != next) {
+                    m_incident_edges[current].push_back(m_edges.size());
+                    m_incident_edges[next].push_back(m_edges.size());
+                    m_edges.emplace_back(current, next);
+                }
+            }
+        }
+
+        /*!
+         * Check whether the segment from the vertex in the direction of the target stays in the fly-zone and out of
+         * no-fly zones right near the vertex. Directions along the polygon edges are allowed
+         */
+        bool direction_is_free(size_t vertex, point_t target) const {
+            const point_t &v = m_points[vertex];
+            for (const auto &wedge: m_wedges[vertex]) {
+                double angle = angle_between_vectors(m_points[wedge.previous], v, target);
+                double wedge_angle = angle_between_vectors(m_points[wedge.previous], v, m_points[wedge.next]);
+                bool inside = angle > EPS && angle < wedge_angle - EPS;
+                bool outside = angle > wedge_angle + EPS && angle < 2 * M_PI - EPS;
+                if (wedge.fly_zone ? outside : inside) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /*!
+         * Distance from the ray origin to the intersection of the ray line with the line of the edge
+         */
+        double ray_distance(size_t edge, const sweep_ray_t &ray) const {
+            const point_t &a = m_points[m_edges[edge].first], &b = m_points[m_edges[edge].second];
+            const double dx = ray.target.first - ray.origin.first, dy = ray.target.second - ray.origin.second;
+            const double ex = b.first - a.first, ey = b.second - a.second;
+            const double denominator = dx * ey - dy * ex;
+            if (denominator == 0) {
+                return HUGE_VAL;
+            }
+            const double t = ((a.first - ray.origin.first) * ey - (a.second - ray.origin.second) * ex) / denominator;
+            return t * std::sqrt(dx * dx + dy * dy);
+        }
+    };
+
+    // File layout (native byte order):
+    // magic, version, polygon hash, number of graph vertices, their coordinates, on-demand paths flag,
+    // adjacency list of each vertex (size, then (vertex, length) pairs), distance and next vertex matrices
+    // if the paths are not searched on demand
+    const uint32_t PATHS_MAGIC = 0x48545053; // "SPTH"
+    // Increase on any change of the layout or of the visibility graph construction
+    const uint32_t PATHS_VERSION = 1;
+
+    class PathsWriter {
+    public:
+        template<typename T>
+        void put(T value) {
+            put_array(&value, 1);
+        }
+
+        template<typename T>
+        void put_array(const T *values, size_t count) {
+            auto pos = m_data.size();
+            m_data.resize(pos + count * sizeof(T));
+            std::memcpy(m_data.data() + pos, values, count * sizeof(T));
+        }
+
+        std::vector<uint8_t> &data() { return m_data; }
+
+    private:
+        std::vector<uint8_t> m_data;
+    };
+
+    class PathsReader {
+    public:
+        PathsReader(const uint8_t *data, size_t size) : m_data{data}, m_size{size} {}
+
+        template<typename T>
+        T get() {
+            T value;
+            get_array(&value, 1);
+            return value;
+        }
+
+        template<typename T>
+        void get_array(T *values, size_t count) {
+            if (count > (m_size - m_pos) / sizeof(T)) {
+                throw shortest_paths_file_error("Shortest paths file is truncated");
+            }
+            std::memcpy(values, m_data + m_pos, count * sizeof(T));
+            m_pos += count * sizeof(T);
+        }
+
+        [[nodiscard]] size_t remaining() const { return m_size - m_pos; }
+
+        [[nodiscard]] bool at_end() const { return m_pos == m_size; }
+
+    private:
+        const uint8_t *m_data;
+        size_t m_size;
+        size_t m_pos = 0;
+    };
 
     /*!
-     * Calculate the segments, between which there is no direct path definitely.
-     * Needed for the main algorithm while checking if there is a direct path by
-     * "visibility" of the points (no segment between them). But this situation can also
-     * happen when nodes "see" each other through a no-fly zone (e.g. different points of a convex no-fly zone
-     * of when the fly-zone if non-convex, so there always exist a line between
-     * @param polygon Polygon for which segments will be found
-     * @return
+     * Open ring starting from its smallest point
      */
-    std::set<segment_t> no_direct_path(const MapPolygon &polygon) {
-        std::set<segment_t> no_direct_view = no_direct_path(polygon.fly_zone_polygon_points, true);
-        for (const auto &p: polygon.no_fly_zone_polygons) {
-            auto no_fly_zone_no_view = no_direct_path(p, false);
-            no_direct_view.insert(no_fly_zone_no_view.begin(), no_fly_zone_no_view.end());
+    polygon_t canonical_ring(const polygon_t &ring) {
+        polygon_t res = ring;
+        if (res.size() > 1 && res.front() == res.back()) {
+            res.pop_back();
         }
-        return no_direct_view;
+        std::rotate(res.begin(), std::min_element(res.begin(), res.end()), res.end());
+        return res;
     }
 }
 
-ShortestPathCalculator::ShortestPathCalculator(const MapPolygon &polygon) {
-    auto points_tmp = polygon.get_all_points();
-    m_polygon_points = std::vector<point_t>{points_tmp.begin(), points_tmp.end()};
-    m_polygon_segments = polygon.get_all_segments();
+ShortestPathCalculator::ShortestPathCalculator(const MapPolygon &polygon, ThreadPool *thread_pool) : m_polygon{polygon},
+                                                                                                     m_paths_cache{
+        std::make_shared<PathCache>(PATHS_CACHE_CAPACITY, PATHS_CACHE_QUANTUM)} {
+    init_polygon();
+
+    std::vector<point_t> all_points;
+    std::map<point_t, int> all_point_index;
+    index_polygon_points(polygon, all_points, all_point_index);
+    VisibilitySweep sweep{all_points, polygon, all_point_index};
+    std::vector<bool> reflex(all_points.size());
+    std::vector<size_t> sweep_vertices;
+    for (const auto &p: m_polygon_points) {
+        sweep_vertices.push_back(all_point_index.at(p));
+        reflex[sweep_vertices.back()] = true;
+    }
+
+    // Build the visibility graph by the rotational sweep around each vertex
+    const size_t n = m_polygon_points.size();
+    std::vector<std::vector<size_t>> visible(n);
+    auto sweep_vertices_range = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            visible[i] = sweep.visible_from(sweep_vertices[i], reflex);
+        }
+    };
+    if (thread_pool != nullptr) {
+        thread_pool->parallel_for(n, sweep_vertices_range);
+    } else {
+        sweep_vertices_range(0, n);
+    }
+    std::vector<std::vector<std::pair<uint32_t, double>>> graph(n);
+    for (size_t i = 0; i < n; i++) {
+        for (size_t seen: visible[i]) {
+            size_t j = m_point_index.at(all_points[seen]);
+            graph[i].emplace_back(j, distance_between_points(m_polygon_points[i], m_polygon_points[j]));
+        }
+    }
+    // Polygon edges are always traversable
+    for (const auto &segment: m_polygon_segments) {
+        auto first = m_point_index.find(segment.first), second = m_point_index.find(segment.second);
+        if (first == m_point_index.end() || second == m_point_index.end() || first->second == second->second) {
+            continue;
+        }
+        graph[first->second].emplace_back(second->second, segment_length(segment));
+        graph[second->second].emplace_back(first->second, segment_length(segment));
+    }
+
+    m_visibility_graph = std::move(graph);
+
+    // For large polygons the all-pairs matrices would take too much memory and time. Search paths on demand instead
+    m_lazy_shortest_paths = n >= LAZY_SHORTEST_PATHS_MIN_VERTICES;
+    if (m_lazy_shortest_paths) {
+        return;
+    }
+
+    // Row-major matrices of the shortest path lengths and of the next vertex in the shortest path between each pair
+    m_next_vertex_in_path = std::vector<uint32_t>(n * n, NO_VERTEX);
+    m_floyd_warshall_d = std::vector<double>(n * n, HUGE_VAL);
+    for (size_t i = 0; i < n; i++) {
+        m_floyd_warshall_d[i * n + i] = 0;
+        for (const auto &[j, length]: m_visibility_graph[i]) {
+            m_floyd_warshall_d[i * n + j] = length;
+            m_next_vertex_in_path[i * n + j] = j;
+        }
+    }
+    run_floyd_warshall(thread_pool);
+}
+
+
+void ShortestPathCalculator::init_polygon() {
+    m_polygon_segments = m_polygon.get_all_segments();
+    m_segment_grid = SegmentGrid{m_polygon_segments};
+
+    // Shortest paths bend only at reflex vertices, so only they become nodes of the visibility graph
+    std::vector<point_t> all_points;
+    std::map<point_t, int> all_point_index;
+    index_polygon_points(m_polygon, all_points, all_point_index);
+    VisibilitySweep sweep{all_points, m_polygon, all_point_index};
+    for (size_t i = 0; i < all_points.size(); ++i) {
+        if (sweep.is_reflex(i)) {
+            m_polygon_points.push_back(all_points[i]);
+        }
+    }
+    m_point_tree = PointKdTree{m_polygon_points};
 
     // Assign each point a unique identifier to be able to quickly traverse through it
     int index = 0;
     for (const auto &p: m_polygon_points) {
         m_point_index[p] = index++;
     }
+}
 
-    // Create a 2-d matrix that will contain paths for the shortest path between each of perimeter point
-    // And 2-d matrix for the Floyd-Warshall algorithm
-    m_next_vertex_in_path = std::vector<std::vector<size_t>>(m_polygon_points.size());
-    std::for_each(m_next_vertex_in_path.begin(), m_next_vertex_in_path.end(),
-                  [&](auto &row) { row = std::vector<size_t>(m_polygon_points.size(), -1); });
-    m_floyd_warshall_d = std::vector<std::vector<double>>(m_polygon_points.size());
-    std::for_each(m_floyd_warshall_d.begin(), m_floyd_warshall_d.end(),
-                  [&](auto &row) { row = std::vector<double>(m_polygon_points.size(), HUGE_VAL); });
-
-    // Get the list of pairs of points, for which there is no direct path even if they can "see" each other
-    auto no_direct_path_pairs = no_direct_path(polygon);
-
-    // O(N^3) building of the matrix. Ok as the algorithm itself runs on O(N^3)
-    for (size_t i = 0; i < m_polygon_points.size(); i++) {
-        m_floyd_warshall_d[i][i] = 0;
-        for (size_t j = i + 1; j < m_polygon_points.size(); j++) {
-            segment_t segment_between_point = {m_polygon_points[i], m_polygon_points[j]};
-            if (m_polygon_points[i] == m_polygon_points[j]) {
-                continue;
+MapPolygon ShortestPathCalculator::current_polygon() const {
+    MapPolygon polygon = m_polygon;
+    for (const auto &[id, obstacle]: m_obstacles) {
+        polygon.no_fly_zone_polygons.push_back(obstacle);
+    }
+    return polygon;
+}
+
+ShortestPathCalculator::ShortestPathCalculator(const MapPolygon &polygon, const uint8_t *paths, size_t paths_size)
+        : m_polygon{polygon}, m_paths_cache{std::make_shared<PathCache>(PATHS_CACHE_CAPACITY, PATHS_CACHE_QUANTUM)} {
+    PathsReader reader{paths, paths_size};
+    if (reader.get<uint32_t>() != PATHS_MAGIC) {
+        throw shortest_paths_file_error("Not a shortest paths file");
+    }
+    if (reader.get<uint32_t>() != PATHS_VERSION) {
+        throw shortest_paths_file_error("Shortest paths file has an unsupported version");
+    }
+    if (reader.get<uint64_t>() != polygon_hash(polygon)) {
+        throw shortest_paths_file_error("Shortest paths file was saved for another polygon");
+    }
+
+    // The vertices are cheap to find again. Comparing them with the saved ones guards against hash collisions
+    init_polygon();
+    const size_t n = m_polygon_points.size();
+    if (reader.get<uint64_t>() != n) {
+        throw shortest_paths_file_error("Shortest paths file has another number of vertices");
+    }
+    for (const auto &p: m_polygon_points) {
+        double x = reader.get<double>(), y = reader.get<double>();
+        if (x != p.first || y != p.second) {
+            throw shortest_paths_file_error("Shortest paths file has other vertices");
+        }
+    }
+
+    m_lazy_shortest_paths = reader.get<uint8_t>() != 0;
+    m_visibility_graph.resize(n);
+    for (auto &edges: m_visibility_graph) {
+        // The count is checked before allocating, so that a corrupted file cannot exhaust the memory
+        auto n_edges = reader.get<uint32_t>();
+        if (n_edges > n || n_edges > reader.remaining() / (sizeof(uint32_t) + sizeof(double))) {
+            throw shortest_paths_file_error("Shortest paths file has a wrong number of edges");
+        }
+        edges.resize(n_edges);
+        for (auto &[vertex, length]: edges) {
+            vertex = reader.get<uint32_t>();
+            length = reader.get<double>();
+            if (vertex >= n) {
+                throw shortest_paths_file_error("Shortest paths file has an edge to a non-existing vertex");
+            }
+            if (!std::isfinite(length) || length < 0) {
+                throw shortest_paths_file_error("Shortest paths file has an edge of an invalid length");
+            }
+        }
+    }
+    if (!m_lazy_shortest_paths) {
+        m_floyd_warshall_d.resize(n * n);
+        reader.get_array(m_floyd_warshall_d.data(), n * n);
+        m_next_vertex_in_path.resize(n * n);
+        reader.get_array(m_next_vertex_in_path.data(), n * n);
+        for (size_t i = 0; i < n * n; ++i) {
+            double d = m_floyd_warshall_d[i];
+            if (std::isnan(d) || d < 0) {
+                throw shortest_paths_file_error("Shortest paths file has a path of an invalid length");
+            }
+            uint32_t next = m_next_vertex_in_path[i];
+            if (next >= n && next != NO_VERTEX) {
+                throw shortest_paths_file_error("Shortest paths file has a path through a non-existing vertex");
             }
+        }
+        if (!next_vertices_reach_targets()) {
+            throw shortest_paths_file_error("Shortest paths file has a path that does not reach its end");
+        }
+    }
+    if (!reader.at_end()) {
+        throw shortest_paths_file_error("Shortest paths file has extra data at the end");
+    }
+}
 
-            // If there is no direct path by previously calculated algorithm, omit this pair
-            if (no_direct_path_pairs.find(segment_between_point) != no_direct_path_pairs.end() ||
-                no_direct_path_pairs.find({segment_between_point.second, segment_between_point.first}) !=
-                no_direct_path_pairs.end()) {
-                continue;
+bool ShortestPathCalculator::next_vertices_reach_targets() const {
+    // The next vertices towards one target form a tree rooted in it. Each vertex is walked through at most once per
+    // target, as the walk stops at the vertices known to reach the target already
+    enum : uint8_t { UNKNOWN, ON_WALK, REACHES, UNREACHABLE };
+    const size_t n = m_polygon_points.size();
+    std::vector<uint8_t> state(n);
+    std::vector<size_t> walk;
+    for (size_t j = 0; j < n; ++j) {
+        std::fill(state.begin(), state.end(), UNKNOWN);
+        state[j] = REACHES;
+        for (size_t i = 0; i < n; ++i) {
+            if (m_next_vertex_in_path[i * n + j] == NO_VERTEX && state[i] == UNKNOWN) {
+                // Only the vertices with no path to the target may have no next vertex
+                if (m_floyd_warshall_d[i * n + j] != HUGE_VAL) {
+                    return false;
+                }
+                state[i] = UNREACHABLE;
             }
+        }
+        for (size_t i = 0; i < n; ++i) {
+            walk.clear();
+            size_t v = i;
+            while (state[v] == UNKNOWN) {
+                state[v] = ON_WALK;
+                walk.push_back(v);
+                v = m_next_vertex_in_path[v * n + j];
+            }
+            // A cycle or a walk into a vertex with no path to the target never reaches the target
+            if (!walk.empty() && state[v] != REACHES) {
+                return false;
+            }
+            for (size_t w: walk) {
+                state[w] = REACHES;
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<uint8_t> ShortestPathCalculator::save_paths() const {
+    PathsWriter writer;
+    writer.put(PATHS_MAGIC);
+    writer.put(PATHS_VERSION);
+    writer.put(polygon_hash(current_polygon()));
+
+    const size_t n = m_polygon_points.size();
+    writer.put(static_cast<uint64_t>(n));
+    for (const auto &p: m_polygon_points) {
+        writer.put(p.first);
+        writer.put(p.second);
+    }
+    writer.put(static_cast<uint8_t>(m_lazy_shortest_paths));
+    for (const auto &edges: m_visibility_graph) {
+        writer.put(static_cast<uint32_t>(edges.size()));
+        // Field by field, as the pairs have padding
+        for (const auto &[vertex, length]: edges) {
+            writer.put(vertex);
+            writer.put(length);
+        }
+    }
+    if (!m_lazy_shortest_paths) {
+        writer.put_array(m_floyd_warshall_d.data(), n * n);
+        writer.put_array(m_next_vertex_in_path.data(), n * n);
+    }
+    return std::move(writer.data());
+}
+
+uint64_t ShortestPathCalculator::polygon_hash(const MapPolygon &polygon) {
+    std::vector<polygon_t> no_fly_zones;
+    for (const auto &no_fly_zone: polygon.no_fly_zone_polygons) {
+        no_fly_zones.push_back(canonical_ring(no_fly_zone));
+    }
+    std::sort(no_fly_zones.begin(), no_fly_zones.end());
+
+    uint64_t hash = 0;
+    auto add_ring = [&](const polygon_t &ring) {
+        hash = hash_mix(hash ^ ring.size());
+        for (const auto &p: ring) {
+            for (double coordinate: {p.first, p.second}) {
+                // Adding 0.0 turns -0.0 into 0.0, so that equal coordinates have equal bits
+                coordinate += 0.0;
+                uint64_t bits;
+                std::memcpy(&bits, &coordinate, sizeof(bits));
+                hash = hash_mix(hash ^ bits);
+            }
+        }
+    };
+    add_ring(canonical_ring(polygon.fly_zone_polygon_points));
+    for (const auto &no_fly_zone: no_fly_zones) {
+        add_ring(no_fly_zone);
+    }
+    return hash;
+}
+
+void ShortestPathCalculator::run_floyd_warshall(ThreadPool *thread_pool) {
+    const size_t n = m_polygon_points.size();
+    const size_t n_blocks = (n + FLOYD_WARSHALL_BLOCK - 1) / FLOYD_WARSHALL_BLOCK;
+    double *d = m_floyd_warshall_d.data();
+    uint32_t *next = m_next_vertex_in_path.data();
+
+    auto for_each_tile = [&](size_t n_tiles, const std::function<void(size_t)> &relax) {
+        auto relax_range = [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t) {
+                relax(t);
+            }
+        };
+        if (thread_pool != nullptr && n_tiles > 1) {
+            thread_pool->parallel_for(n_tiles, relax_range);
+        } else {
+            relax_range(0, n_tiles);
+        }
+    };
+
+    // Blocked Floyd-Warshall. For each block of intermediate vertices, the diagonal tile is relaxed first, then the
+    // tiles in its row and column (depend only on the diagonal one) and then all the others (depend only on the
+    // row and column). Tiles within each of the last two phases are independent and are relaxed in parallel
+    for (size_t bk = 0; bk < n_blocks; ++bk) {
+        relax_tile(d, next, n, bk, bk, bk);
+        for_each_tile(2 * (n_blocks - 1), [&](size_t t) {
+            size_t b = t / 2 < bk ? t / 2 : t / 2 + 1;
+            if (t % 2 == 0) {
+                relax_tile(d, next, n, bk, b, bk);
+            } else {
+                relax_tile(d, next, n, b, bk, bk);
+            }
+        });
+        for_each_tile((n_blocks - 1) * (n_blocks - 1), [&](size_t t) {
+            size_t bi = t / (n_blocks - 1), bj = t % (n_blocks - 1);
+            relax_tile(d, next, n, bi < bk ? bi : bi + 1, bj < bk ? bj : bj + 1, bk);
+        });
+    }
+}
+
+size_t ShortestPathCalculator::add_obstacle(polygon_t obstacle, ThreadPool *thread_pool) {
+    if (obstacle.size() > 1 && obstacle.front() == obstacle.back()) {
+        obstacle.pop_back();
+    }
+    if (obstacle.size() < 3) {
+        throw shortest_path_calculation_error("No-fly zone should have at least 3 points");
+    }
+    // Same as the rings of MapPolygon: closed and clockwise
+    obstacle.push_back(obstacle.front());
+    make_polygon_clockwise(obstacle);
+
+    size_t id = m_next_obstacle_id++;
+    auto box = bounding_box(obstacle);
+    m_obstacles.emplace(id, std::move(obstacle));
+    update_obstacles(box, false, thread_pool);
+    return id;
+}
+
+void ShortestPathCalculator::remove_obstacle(size_t id, ThreadPool *thread_pool) {
+    auto it = m_obstacles.find(id);
+    if (it == m_obstacles.end()) {
+        throw shortest_path_calculation_error("No no-fly zone with identifier " + std::to_string(id));
+    }
+    auto box = bounding_box(it->second);
+    m_obstacles.erase(it);
+    update_obstacles(box, true, thread_pool);
+}
+
+void ShortestPathCalculator::update_obstacles(std::pair<point_t, point_t> box, bool removed, ThreadPool *thread_pool) {
+    MapPolygon polygon = current_polygon();
+    std::vector<point_t> all_points;
+    std::map<point_t, int> all_point_index;
+    index_polygon_points(polygon, all_points, all_point_index);
+    m_polygon_segments = polygon.get_all_segments();
+    m_segment_grid = SegmentGrid{m_polygon_segments};
+    VisibilitySweep sweep{all_points, polygon, all_point_index};
+    SegmentGrid edge_grid{sweep.edge_segments()};
+
+    // Vertices of the new graph. The ones that were in the old graph are mapped to their old indices
+    const size_t old_n = m_polygon_points.size();
+    std::vector<point_t> points;
+    std::vector<size_t> sweep_vertices;
+    std::vector<bool> reflex(all_points.size());
+    std::vector<uint32_t> old_to_new(old_n, NO_VERTEX), new_to_old, new_vertices;
+    for (size_t i = 0; i < all_points.size(); ++i) {
+        reflex[i] = sweep.is_reflex(i);
+        if (!reflex[i]) {
+            continue;
+        }
+        auto old = m_point_index.find(all_points[i]);
+        auto v = static_cast<uint32_t>(points.size());
+        if (old == m_point_index.end()) {
+            new_to_old.push_back(NO_VERTEX);
+            new_vertices.push_back(v);
+        } else {
+            new_to_old.push_back(old->second);
+            old_to_new[old->second] = v;
+        }
+        points.push_back(all_points[i]);
+        sweep_vertices.push_back(i);
+    }
+    const size_t n = points.size();
+    std::map<point_t, int> point_index;
+    for (size_t i = 0; i < n; ++i) {
+        point_index[points[i]] = static_cast<int>(i);
+    }
+
+    // Only the segments crossing the changed no-fly zone can change their visibility
+    auto crosses_box = [&](point_t a, point_t b) {
+        return SegmentGrid::clip_segment(box.first.first, box.first.second, box.second.first, box.second.second, a,
+                                         b);
+    };
+    auto for_each_vertex = [&](size_t n_vertices, const std::function<void(size_t)> &f) {
+        auto range = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                f(i);
+            }
+        };
+        if (thread_pool != nullptr) {
+            thread_pool->parallel_for(n_vertices, range);
+        } else {
+            range(0, n_vertices);
+        }
+    };
 
-            bool segment_intersects = false;
-            for (const auto &segment: m_polygon_segments) {
-                // If there is an exact edge between these two points -- break as there won't be any intersections anymore
-                if ((segment.first == segment_between_point.first && segment.second == segment_between_point.second) ||
-                    (segment.second == segment_between_point.first && segment.first == segment_between_point.second)) {
-                    segment_intersects = false;
-                    break;
+    // Edges between the old vertices, as (old index, old index, length)
+    std::vector<std::tuple<uint32_t, uint32_t, double>> removed_edges, added_edges;
+    std::vector<std::vector<std::pair<uint32_t, double>>> graph(n);
+    for (size_t u_old = 0; u_old < old_n; ++u_old) {
+        for (const auto &[v_old, length]: m_visibility_graph[u_old]) {
+            if (v_old < u_old) {
+                continue;
+            }
+            uint32_t u = old_to_new[u_old], v = old_to_new[v_old];
+            // An added no-fly zone can only hide the vertices from each other
+            bool kept = u != NO_VERTEX && v != NO_VERTEX &&
+                        (removed || !crosses_box(points[u], points[v]) ||
+                         sweep.vertex_sees_vertex(sweep_vertices[u], sweep_vertices[v], edge_grid));
+            if (kept) {
+                graph[u].emplace_back(v, length);
+                graph[v].emplace_back(u, length);
+            } else {
+                removed_edges.emplace_back(u_old, v_old, length);
+            }
+        }
+    }
+    if (removed) {
+        // A removed no-fly zone can only open the view between the vertices it separated
+        std::vector<std::vector<uint32_t>> opened(n);
+        for_each_vertex(n, [&](size_t u) {
+            if (new_to_old[u] == NO_VERTEX) {
+                return;
+            }
+            std::vector<bool> adjacent(n);
+            for (const auto &edge: graph[u]) {
+                adjacent[edge.first] = true;
+            }
+            for (size_t v = u + 1; v < n; ++v) {
+                if (new_to_old[v] != NO_VERTEX && !adjacent[v] && crosses_box(points[u], points[v]) &&
+                    sweep.vertex_sees_vertex(sweep_vertices[u], sweep_vertices[v], edge_grid)) {
+                    opened[u].push_back(v);
                 }
+            }
+        });
+        for (size_t u = 0; u < n; ++u) {
+            for (uint32_t v: opened[u]) {
+                double length = distance_between_points(points[u], points[v]);
+                graph[u].emplace_back(v, length);
+                graph[v].emplace_back(u, length);
+                added_edges.emplace_back(new_to_old[u], new_to_old[v], length);
+            }
+        }
+    }
 
-                // If the segment starts in point - don't check it for intersection as it will intersect in that point
-                if (segment.first == segment_between_point.first || segment.second == segment_between_point.first ||
-                    segment.first == segment_between_point.second || segment.second == segment_between_point.second) {
-                    continue;
+    // The vertices of an added no-fly zone are connected by the full sweep around each of them
+    std::vector<bool> graph_vertices(all_points.size());
+    for (size_t v: sweep_vertices) {
+        graph_vertices[v] = true;
+    }
+    std::vector<std::vector<size_t>> visible(new_vertices.size());
+    for_each_vertex(new_vertices.size(), [&](size_t i) {
+        visible[i] = sweep.visible_from(sweep_vertices[new_vertices[i]], graph_vertices);
+    });
+    for (size_t i = 0; i < new_vertices.size(); ++i) {
+        uint32_t u = new_vertices[i];
+        for (size_t seen: visible[i]) {
+            auto v = static_cast<uint32_t>(point_index.at(all_points[seen]));
+            double length = distance_between_points(points[u], points[v]);
+            graph[u].emplace_back(v, length);
+            if (new_to_old[v] != NO_VERTEX) {
+                graph[v].emplace_back(u, length);
+            }
+        }
+    }
+    for (const auto &segment: m_polygon_segments) {
+        auto first = point_index.find(segment.first), second = point_index.find(segment.second);
+        if (first == point_index.end() || second == point_index.end() || first->second == second->second ||
+            (new_to_old[first->second] != NO_VERTEX && new_to_old[second->second] != NO_VERTEX)) {
+            continue;
+        }
+        graph[first->second].emplace_back(second->second, segment_length(segment));
+        graph[second->second].emplace_back(first->second, segment_length(segment));
+    }
+
+    if (!m_lazy_shortest_paths) {
+        // Distances in an old row stay the same if none of its shortest paths used a removed edge and no added edge
+        // makes any of them shorter. Only the other rows and the rows of the new vertices are recalculated
+        // Not std::vector<bool>, as its elements are set from several threads
+        std::vector<char> row_changed(old_n, false);
+        for_each_vertex(old_n, [&](size_t i) {
+            const double *d_i = m_floyd_warshall_d.data() + i * old_n;
+            for (const auto &[u, v, length]: removed_edges) {
+                if (d_i[u] + length <= d_i[v] + EPS || d_i[v] + length <= d_i[u] + EPS) {
+                    row_changed[i] = true;
+                    return;
+                }
+            }
+            for (const auto &[u, v, length]: added_edges) {
+                if (d_i[u] + length < d_i[v] - EPS || d_i[v] + length < d_i[u] - EPS) {
+                    row_changed[i] = true;
+                    return;
                 }
+            }
+        });
 
-                if (segments_intersect(segment, segment_between_point)) {
-                    segment_intersects = true;
-                    break;
+        std::vector<double> d(n * n, HUGE_VAL);
+        std::vector<uint32_t> next(n * n, NO_VERTEX);
+        std::vector<size_t> rows_to_recalculate;
+        for (size_t i = 0; i < n; ++i) {
+            const size_t i_old = new_to_old[i];
+            if (i_old == NO_VERTEX || row_changed[i_old]) {
+                rows_to_recalculate.push_back(i);
+                continue;
+            }
+            for (size_t j = 0; j < n; ++j) {
+                const size_t j_old = new_to_old[j];
+                if (j_old != NO_VERTEX) {
+                    d[i * n + j] = m_floyd_warshall_d[i_old * old_n + j_old];
+                    uint32_t next_old = m_next_vertex_in_path[i_old * old_n + j_old];
+                    next[i * n + j] = next_old == NO_VERTEX ? NO_VERTEX : old_to_new[next_old];
                 }
             }
-            if (!segment_intersects) {
-                // Update Floyd Warshall algorithm matrix
-                m_floyd_warshall_d[i][j] = m_floyd_warshall_d[j][i] = segment_length(segment_between_point);
-                m_next_vertex_in_path[i][j] = j;
-                m_next_vertex_in_path[j][i] = i;
+            // Paths to the new vertices come from the old ones, so relax only the edges of the new vertices
+            for (bool relaxed = true; relaxed;) {
+                relaxed = false;
+                for (uint32_t u: new_vertices) {
+                    for (const auto &[v, length]: graph[u]) {
+                        if (d[i * n + v] + length < d[i * n + u]) {
+                            d[i * n + u] = d[i * n + v] + length;
+                            next[i * n + u] = v == i ? u : next[i * n + v];
+                            relaxed = true;
+                        }
+                    }
+                }
             }
         }
+
+        m_visibility_graph = std::move(graph);
+        for_each_vertex(rows_to_recalculate.size(), [&](size_t r) {
+            const size_t i = rows_to_recalculate[r];
+            shortest_paths_from_vertex(i, d.data() + i * n, next.data() + i * n);
+        });
+        m_floyd_warshall_d = std::move(d);
+        m_next_vertex_in_path = std::move(next);
+    } else {
+        m_visibility_graph = std::move(graph);
+    }
+
+    m_polygon_points = std::move(points);
+    m_point_index = std::move(point_index);
+    m_point_tree = PointKdTree{m_polygon_points};
+    // The cache may still be used by the copies of the calculator with the previous no-fly zones
+    m_paths_cache = std::make_shared<PathCache>(PATHS_CACHE_CAPACITY, PATHS_CACHE_QUANTUM);
+    if (!m_query_point_index.empty()) {
+        std::vector<point_t> query_points(m_query_point_index.size());
+        for (const auto &[p, i]: m_query_point_index) {
+            query_points[i] = p;
+        }
+        m_query_point_index.clear();
+        register_query_points(query_points, thread_pool);
     }
-    run_floyd_warshall();
 }
 
+void ShortestPathCalculator::shortest_paths_from_vertex(size_t source, double *d, uint32_t *next) const {
+    const size_t n = m_visibility_graph.size();
+    std::fill(d, d + n, HUGE_VAL);
+    std::fill(next, next + n, NO_VERTEX);
+    d[source] = 0;
 
-void ShortestPathCalculator::run_floyd_warshall() {
-    const size_t N = m_floyd_warshall_d.size();
-    for (size_t k = 0; k < N; ++k) {
-        for (size_t i = 0; i < N; ++i) {
-            for (size_t j = 0; j < N; ++j) {
-                if (m_floyd_warshall_d[i][j] > m_floyd_warshall_d[i][k] + m_floyd_warshall_d[k][j]) {
-                    m_floyd_warshall_d[i][j] = m_floyd_warshall_d[i][k] + m_floyd_warshall_d[k][j];
-                    m_floyd_warshall_d[j][i] = m_floyd_warshall_d[i][j];
-                    // Now, to get to j from i, we should in direction to k (to next vertex in path to k)
-                    m_next_vertex_in_path[i][j] = m_next_vertex_in_path[i][k];
-                    m_next_vertex_in_path[j][i] = m_next_vertex_in_path[j][k];
+    using queue_entry_t = std::pair<double, uint32_t>;
+    std::priority_queue<queue_entry_t, std::vector<queue_entry_t>, std::greater<>> open;
+    open.emplace(0, source);
+    while (!open.empty()) {
+        auto [cost, v] = open.top();
+        open.pop();
+        if (cost > d[v]) {
+            continue;
+        }
+        for (const auto &[u, length]: m_visibility_graph[v]) {
+            if (cost + length < d[u]) {
+                d[u] = cost + length;
+                next[u] = v == source ? u : next[v];
+                open.emplace(d[u], u);
+            }
+        }
+    }
+}
+
+void ShortestPathCalculator::register_query_points(const std::vector<point_t> &points, ThreadPool *thread_pool) {
+    // The previous registration stays in use by the queries below until the new one is complete
+    std::map<point_t, size_t> index;
+    std::vector<point_t> query_points;
+    for (const auto &p: points) {
+        if (index.emplace(p, query_points.size()).second) {
+            query_points.push_back(p);
+        }
+    }
+
+    // Each task fills its own rows, and rows are padded to whole words, so no two tasks write to the same word.
+    // Only the upper triangle is checked, the lower one is mirrored afterwards
+    const size_t n = query_points.size();
+    const size_t row_words = (n + 63) / 64;
+    std::vector<std::vector<std::pair<size_t, double>>> seen(n);
+    std::vector<uint64_t> visibility(n * row_words, 0);
+    auto register_range = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            seen[i] = seen_vertices(query_points[i]);
+            for (size_t j = i; j < n; ++j) {
+                if (point_can_see_point(query_points[i], query_points[j])) {
+                    visibility[i * row_words + j / 64] |= uint64_t{1} << (j % 64);
                 }
             }
         }
+    };
+    if (thread_pool != nullptr) {
+        thread_pool->parallel_for(n, register_range);
+    } else {
+        register_range(0, n);
     }
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i + 1; j < n; ++j) {
+            if (visibility[i * row_words + j / 64] >> (j % 64) & 1) {
+                visibility[j * row_words + i / 64] |= uint64_t{1} << (i % 64);
+            }
+        }
+    }
+
+    m_query_point_index = std::move(index);
+    m_query_point_seen_vertices = std::move(seen);
+    m_query_points_visibility = std::move(visibility);
+    m_query_points_visibility_row_words = row_words;
+}
+
+size_t ShortestPathCalculator::query_point_index(point_t p) const {
+    auto it = m_query_point_index.find(p);
+    return it == m_query_point_index.end() ? NO_QUERY_POINT : it->second;
 }
 
 std::vector<point_t> ShortestPathCalculator::get_approximate_shortest_path(point_t p1, point_t p2) const {
-    if (point_can_see_point(p1, p2)) {
+    if (point_can_see_point(p1, p2) || m_polygon_points.empty()) {
         return std::vector<point_t>{p1, p2};
     }
 
     point_t closest_to_start = closest_polygon_point(p1);
     point_t closest_to_end = closest_polygon_point(p2);
 
-    auto path_between_closest = shortest_path_between_polygon_nodes(m_point_index[closest_to_start],
-                                                                    m_point_index[closest_to_end]);
+    auto path_between_closest = shortest_path_between_polygon_nodes(m_point_index.at(closest_to_start),
+                                                                    m_point_index.at(closest_to_end));
     // TODO: can check if the second path point can be reached directly from p1 to make path feasible
 
     path_between_closest.insert(path_between_closest.begin(), p1);
@@ -184,25 +1106,25 @@ point_t ShortestPathCalculator::closest_polygon_point(point_t p) const {
     if (m_polygon_points.empty()) {
         throw shortest_path_calculation_error("No point in the polygon found");
     }
-    point_t closest_point = m_point_index.begin()->first;
-    double closest_distance = distance_between_points(closest_point, p);
-    for (const auto &point: m_polygon_points) {
-        double new_distance = distance_between_points(point, p);
-        if (new_distance < closest_distance) {
-            closest_distance = new_distance;
-            closest_point = point;
-        }
-    }
-    return closest_point;
+    return m_polygon_points[m_point_tree.nearest(p)];
 }
 
 
 std::vector<point_t> ShortestPathCalculator::shortest_path_between_polygon_nodes(size_t i, size_t j) const {
+    if (m_lazy_shortest_paths) {
+        if (auto path_in_cache = m_paths_cache->find(m_polygon_points[i], m_polygon_points[j])) {
+            return *path_in_cache;
+        }
+        auto res = a_star_path({{i, 0}}, {{j, 0}}, m_polygon_points[j]);
+        m_paths_cache->insert(res);
+        return res;
+    }
+
     // Use the matrix, built using Floyd Warshall to traverse through the shortest path
     std::vector<point_t> res;
     while (i != j) {
         res.push_back(m_polygon_points[i]);
-        i = m_next_vertex_in_path[i][j];
+        i = m_next_vertex_in_path[i * m_polygon_points.size() + j];
     }
     res.push_back(m_polygon_points[j]);
     return res;
@@ -210,47 +1132,186 @@ std::vector<point_t> ShortestPathCalculator::shortest_path_between_polygon_nodes
 
 std::vector<point_t> ShortestPathCalculator::shortest_path_between_points(point_t p1, point_t p2) const {
     // If path is saved to cache - return it from there
-    auto path_in_cache = paths_cache.find({p1, p2});
-    if (path_in_cache != paths_cache.end()) {
-        return path_in_cache->second;
+    if (auto path_in_cache = m_paths_cache->find(p1, p2)) {
+        return *path_in_cache;
     }
-    if (point_can_see_point(p1, p2)) {
+    if (point_can_see_point(p1, query_point_index(p1), p2, query_point_index(p2))) {
         return {p1, p2};
     }
 
-    std::vector<size_t> seen_from_p1, seen_from_p2;
-    for (const auto &p: m_polygon_points) {
-        if (point_can_see_point(p1, p)) {
-            seen_from_p1.push_back(m_point_index[p]);
-        }
-        if (point_can_see_point(p2, p)) {
-            seen_from_p2.push_back(m_point_index[p]);
-        }
-    }
+    auto seen_from_p1 = seen_vertices(p1), seen_from_p2 = seen_vertices(p2);
     if (seen_from_p2.empty() || seen_from_p1.empty()) {
         // Should never get here. Just return a value to not throw exceptions
         return {p1, p2};
     }
 
-    size_t best_i_neighbor = seen_from_p1[0];
-    size_t best_j_neighbor = seen_from_p2[0];
-    double best_path_cost = std::numeric_limits<double>::max();
-    for (auto from_p1: seen_from_p1) {
-        for (auto from_p2: seen_from_p2) {
-            double path_cost = distance_between_points(p1, m_polygon_points[from_p1]) +
-                               distance_between_points(p2, m_polygon_points[from_p2]) +
-                               m_floyd_warshall_d[from_p1][from_p2];
-            if (path_cost < best_path_cost) {
-                best_path_cost = path_cost;
-                best_i_neighbor = from_p1;
-                best_j_neighbor = from_p2;
+    std::vector<point_t> res;
+    if (m_lazy_shortest_paths) {
+        res = a_star_path(seen_from_p1, seen_from_p2, p2);
+    } else {
+        size_t best_i_neighbor = seen_from_p1[0].first;
+        size_t best_j_neighbor = seen_from_p2[0].first;
+        double best_path_cost = std::numeric_limits<double>::max();
+        for (const auto &[from_p1, p1_distance]: seen_from_p1) {
+            for (const auto &[from_p2, p2_distance]: seen_from_p2) {
+                double path_cost = p1_distance + p2_distance +
+                                   m_floyd_warshall_d[from_p1 * m_polygon_points.size() + from_p2];
+                if (path_cost < best_path_cost) {
+                    best_path_cost = path_cost;
+                    best_i_neighbor = from_p1;
+                    best_j_neighbor = from_p2;
+                }
             }
         }
+        res = shortest_path_between_polygon_nodes(best_i_neighbor, best_j_neighbor);
     }
-    auto res = shortest_path_between_polygon_nodes(best_i_neighbor, best_j_neighbor);
     res.insert(res.begin(), p1);
     res.insert(res.end(), p2);
-    paths_cache[{p1, p2}] = res;
+    m_paths_cache->insert(res);
+    return res;
+}
+
+std::vector<point_t> ShortestPathCalculator::a_star_path(const std::vector<std::pair<size_t, double>> &sources,
+                                                        const std::vector<std::pair<size_t, double>> &targets,
+                                                        point_t goal) const {
+    const size_t n = m_polygon_points.size();
+    std::vector<double> cost(n, HUGE_VAL), cost_to_goal(n, HUGE_VAL);
+    std::vector<uint32_t> previous(n, NO_VERTEX);
+    for (const auto &[target, target_cost]: targets) {
+        cost_to_goal[target] = std::min(cost_to_goal[target], target_cost);
+    }
+
+    // Straight line distance to the goal never overestimates the remaining path length
+    auto heuristic = [&](size_t v) { return distance_between_points(m_polygon_points[v], goal); };
+    using queue_entry_t = std::pair<double, uint32_t>;
+    std::priority_queue<queue_entry_t, std::vector<queue_entry_t>, std::greater<>> open;
+    for (const auto &[source, source_cost]: sources) {
+        if (source_cost < cost[source]) {
+            cost[source] = source_cost;
+            open.emplace(source_cost + heuristic(source), source);
+        }
+    }
+
+    double best_cost = HUGE_VAL;
+    size_t best_target = NO_VERTEX;
+    while (!open.empty()) {
+        auto [estimate, v] = open.top();
+        open.pop();
+        // No path through the remaining vertices can be shorter than the one found
+        if (estimate >= best_cost) {
+            break;
+        }
+        // Outdated entry. The vertex was reached by a shorter path after it was pushed
+        if (estimate > cost[v] + heuristic(v)) {
+            continue;
+        }
+        if (cost[v] + cost_to_goal[v] < best_cost) {
+            best_cost = cost[v] + cost_to_goal[v];
+            best_target = v;
+        }
+        for (const auto &[u, length]: m_visibility_graph[v]) {
+            if (cost[v] + length < cost[u]) {
+                cost[u] = cost[v] + length;
+                previous[u] = v;
+                open.emplace(cost[u] + heuristic(u), u);
+            }
+        }
+    }
+
+    std::vector<point_t> res;
+    for (size_t v = best_target; v != NO_VERTEX; v = previous[v]) {
+        res.push_back(m_polygon_points[v]);
+    }
+    std::reverse(res.begin(), res.end());
+    return res;
+}
+
+std::vector<double> ShortestPathCalculator::distances_from(point_t source, const std::vector<point_t> &targets) const {
+    return distance_matrix({source}, targets);
+}
+
+std::vector<double> ShortestPathCalculator::distance_matrix(const std::vector<point_t> &sources,
+                                                           const std::vector<point_t> &targets) const {
+    // Connect each point to the graph only once
+    std::vector<std::vector<std::pair<size_t, double>>> seen_from_targets(targets.size());
+    std::vector<size_t> targets_query_index(targets.size());
+    for (size_t j = 0; j < targets.size(); ++j) {
+        seen_from_targets[j] = seen_vertices(targets[j]);
+        targets_query_index[j] = query_point_index(targets[j]);
+    }
+
+    std::vector<double> res(sources.size() * targets.size());
+    for (size_t i = 0; i < sources.size(); ++i) {
+        auto seen_from_source = seen_vertices(sources[i]);
+        size_t source_query_index = query_point_index(sources[i]);
+        // Length of the shortest path from the source to each graph vertex
+        std::vector<double> vertex_distances = seen_from_source.empty() ? std::vector<double>{}
+                                                                        : graph_distances(seen_from_source);
+        for (size_t j = 0; j < targets.size(); ++j) {
+            double distance = HUGE_VAL;
+            if (!seen_from_source.empty() &&
+                !point_can_see_point(sources[i], source_query_index, targets[j], targets_query_index[j])) {
+                for (const auto &[vertex, vertex_distance]: seen_from_targets[j]) {
+                    distance = std::min(distance, vertex_distances[vertex] + vertex_distance);
+                }
+            }
+            // Same as shortest_path_between_points, fall back to the straight line if there is no path in the graph
+            res[i * targets.size() + j] = distance != HUGE_VAL ? distance
+                                                               : distance_between_points(sources[i], targets[j]);
+        }
+    }
+    return res;
+}
+
+std::vector<std::pair<size_t, double>> ShortestPathCalculator::seen_vertices(point_t p) const {
+    if (size_t q = query_point_index(p); q != NO_QUERY_POINT) {
+        return m_query_point_seen_vertices[q];
+    }
+    std::vector<std::pair<size_t, double>> res;
+    for (size_t i = 0; i < m_polygon_points.size(); ++i) {
+        if (point_can_see_point(p, m_polygon_points[i])) {
+            res.emplace_back(i, distance_between_points(p, m_polygon_points[i]));
+        }
+    }
+    return res;
+}
+
+std::vector<double>
+ShortestPathCalculator::graph_distances(const std::vector<std::pair<size_t, double>> &sources) const {
+    const size_t n = m_polygon_points.size();
+    std::vector<double> res(n, HUGE_VAL);
+    if (!m_lazy_shortest_paths) {
+        for (const auto &[source, source_cost]: sources) {
+            const double *d_source = m_floyd_warshall_d.data() + source * n;
+            for (size_t v = 0; v < n; ++v) {
+                res[v] = std::min(res[v], source_cost + d_source[v]);
+            }
+        }
+        return res;
+    }
+
+    // Dijkstra from all the sources at once
+    using queue_entry_t = std::pair<double, uint32_t>;
+    std::priority_queue<queue_entry_t, std::vector<queue_entry_t>, std::greater<>> open;
+    for (const auto &[source, source_cost]: sources) {
+        if (source_cost < res[source]) {
+            res[source] = source_cost;
+            open.emplace(source_cost, source);
+        }
+    }
+    while (!open.empty()) {
+        auto [cost, v] = open.top();
+        open.pop();
+        if (cost > res[v]) {
+            continue;
+        }
+        for (const auto &[u, length]: m_visibility_graph[v]) {
+            if (cost + length < res[u]) {
+                res[u] = cost + length;
+                open.emplace(res[u], u);
+            }
+        }
+    }
     return res;
 }
 
@@ -267,11 +1328,15 @@ ShortestPathCalculator::farthest_point_seen_in_path(point_t source_point, const
 
 bool ShortestPathCalculator::point_can_see_point(point_t p1, point_t p2) const {
     segment_t segment{p1, p2};
-    for (const auto &border_segment: m_polygon_segments) {
-        if (segments_intersect(segment, border_segment)) {
-            return false;
-        }
-    }
-    return true;
+    // Only the segments in the grid cells along the segment can intersect it
+    return !m_segment_grid.any_segment_along(segment, [&](size_t i) {
+        return segments_intersect(segment, m_polygon_segments[i]);
+    });
 }
 
+bool ShortestPathCalculator::point_can_see_point(point_t p1, size_t q1, point_t p2, size_t q2) const {
+    if (q1 == NO_QUERY_POINT || q2 == NO_QUERY_POINT) {
+        return point_can_see_point(p1, p2);
+    }
+    return m_query_points_visibility[q1 * m_query_points_visibility_row_words + q2 / 64] >> (q2 % 64) & 1;
+}
@@ -0,0 +1,119 @@
+#include "ShortestPathStore.hpp"
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::unique_ptr<const ShortestPathStore::MappedFile> ShortestPathStore::MappedFile::open(const std::string &file_name) {
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat file_stat{};
+    void *data = MAP_FAILED;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // The mapping stays valid after the file is closed
+    close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+    // The whole file is read while loading, so start reading it ahead right away
+    madvise(data, static_cast<size_t>(file_stat.st_size), MADV_WILLNEED);
+    return std::make_unique<const MappedFile>(static_cast<const uint8_t *>(data),
+                                              static_cast<size_t>(file_stat.st_size));
+}
+
+ShortestPathStore::MappedFile::~MappedFile() {
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+}
+
+ShortestPathStore::ShortestPathStore(std::string directory, std::shared_ptr<loggers::SimpleLogger> logger)
+        : m_directory{std::move(directory)}, m_logger{std::move(logger)} {
+}
+
+std::string ShortestPathStore::file_name(uint64_t hash) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash << FILE_EXTENSION;
+    return (std::filesystem::path(m_directory) / name.str()).string();
+}
+
+ShortestPathCalculator ShortestPathStore::get(const MapPolygon &polygon, ThreadPool *thread_pool) const {
+    if (m_directory.empty()) {
+        return ShortestPathCalculator{polygon, thread_pool};
+    }
+    const uint64_t hash = ShortestPathCalculator::polygon_hash(polygon);
+    const std::string name = file_name(hash);
+
+    // The calculator copies everything it needs, so the file is mapped only while it is being loaded
+    if (auto file = MappedFile::open(name)) {
+        try {
+            ShortestPathCalculator res{polygon, file->data(), file->size()};
+            m_logger->log_info("Loaded the shortest paths from " + name);
+            return res;
+        } catch (const shortest_paths_file_error &e) {
+            m_logger->log_warn("Cannot load the shortest paths from " + name + ": " + e.what());
+        }
+    }
+
+    ShortestPathCalculator res{polygon, thread_pool};
+    if (save(name, res.save_paths())) {
+        m_logger->log_info("Saved the shortest paths to " + name);
+    } else {
+        m_logger->log_warn("Cannot save the shortest paths to " + name);
+    }
+    return res;
+}
+
+size_t ShortestPathStore::warm_up() const {
+    std::error_code error;
+    if (m_directory.empty() || !std::filesystem::is_directory(m_directory, error)) {
+        return 0;
+    }
+    size_t res = 0;
+    for (const auto &entry: std::filesystem::directory_iterator(m_directory, error)) {
+        if (entry.path().extension() != FILE_EXTENSION) {
+            continue;
+        }
+        int fd = ::open(entry.path().c_str(), O_RDONLY);
+        if (fd < 0) {
+            continue;
+        }
+        // Only asks the kernel to read the file ahead. The page cache evicts it under memory pressure
+        if (posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) == 0) {
+            ++res;
+        }
+        close(fd);
+    }
+    return res;
+}
+
+bool ShortestPathStore::save(const std::string &file_name, const std::vector<uint8_t> &data) const {
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    const std::string temporary_name = file_name + ".tmp" + std::to_string(getpid()) + "_" +
+                                       std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    {
+        std::ofstream file(temporary_name, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        // Closed explicitly, as a short write may be reported only when the buffer is flushed
+        file.close();
+        if (!file) {
+            std::filesystem::remove(temporary_name, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary_name, file_name, error);
+    if (error) {
+        std::filesystem::remove(temporary_name, error);
+        return false;
+    }
+    return true;
+}
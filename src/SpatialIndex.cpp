@@ -0,0 +1,152 @@
+#include "SpatialIndex.hpp"
+#include <limits>
+
+namespace {
+    // Margin of the cells while registering segments, relative to the cell size. Makes the grid conservative with
+    // respect to rounding errors of the intersection points
+    const double CELL_MARGIN = 1e-3;
+}
+
+SegmentGrid::SegmentGrid(const std::vector<segment_t> &segments) {
+    if (segments.empty()) {
+        return;
+    }
+    double max_x = std::numeric_limits<double>::lowest(), max_y = std::numeric_limits<double>::lowest();
+    m_min_x = m_min_y = std::numeric_limits<double>::max();
+    for (const auto &s: segments) {
+        for (const auto &p: {s.first, s.second}) {
+            m_min_x = std::min(m_min_x, p.first);
+            m_min_y = std::min(m_min_y, p.second);
+            max_x = std::max(max_x, p.first);
+            max_y = std::max(max_y, p.second);
+        }
+    }
+
+    // Approximately one cell per segment, with square cells
+    double width = max_x - m_min_x, height = max_y - m_min_y;
+    double size = std::max(width, height);
+    auto cells_per_side = static_cast<double>(std::max<size_t>(1, static_cast<size_t>(
+            std::ceil(std::sqrt(static_cast<double>(segments.size()))))));
+    m_cell_size = size > 0 ? size / cells_per_side : 1.0;
+    // Extend the grid by one margin so that points on the max border are inside
+    double margin = m_cell_size * CELL_MARGIN;
+    m_min_x -= margin;
+    m_min_y -= margin;
+    m_nx = std::max(1L, static_cast<long>(std::ceil((width + 2 * margin) / m_cell_size)));
+    m_ny = std::max(1L, static_cast<long>(std::ceil((height + 2 * margin) / m_cell_size)));
+
+    // Register each segment in all the cells it crosses with the margin
+    std::vector<std::vector<uint32_t>> cells(static_cast<size_t>(m_nx * m_ny));
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const auto &s = segments[i];
+        long x_from = cell_x(std::min(s.first.first, s.second.first) - margin);
+        long x_to = cell_x(std::max(s.first.first, s.second.first) + margin);
+        long y_from = cell_y(std::min(s.first.second, s.second.second) - margin);
+        long y_to = cell_y(std::max(s.first.second, s.second.second) + margin);
+        for (long iy = y_from; iy <= y_to; ++iy) {
+            for (long ix = x_from; ix <= x_to; ++ix) {
+                point_t a = s.first, b = s.second;
+                double cell_min_x = m_min_x + static_cast<double>(ix) * m_cell_size;
+                double cell_min_y = m_min_y + static_cast<double>(iy) * m_cell_size;
+                if (clip_segment(cell_min_x - margin, cell_min_y - margin, cell_min_x + m_cell_size + margin,
+                                 cell_min_y + m_cell_size + margin, a, b)) {
+                    cells[static_cast<size_t>(iy * m_nx + ix)].push_back(static_cast<uint32_t>(i));
+                }
+            }
+        }
+    }
+
+    m_cell_start.reserve(cells.size() + 1);
+    m_cell_start.push_back(0);
+    for (const auto &cell: cells) {
+        m_cell_segments.insert(m_cell_segments.end(), cell.begin(), cell.end());
+        m_cell_start.push_back(static_cast<uint32_t>(m_cell_segments.size()));
+    }
+}
+
+bool SegmentGrid::clip_segment(double min_x, double min_y, double max_x, double max_y, point_t &a, point_t &b) {
+    double dx = b.first - a.first, dy = b.second - a.second;
+    double t0 = 0, t1 = 1;
+    double p[] = {-dx, dx, -dy, dy};
+    double q[] = {a.first - min_x, max_x - a.first, a.second - min_y, max_y - a.second};
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0) {
+            if (q[i] < 0) {
+                return false;
+            }
+            continue;
+        }
+        double t = q[i] / p[i];
+        if (p[i] < 0) {
+            t0 = std::max(t0, t);
+        } else {
+            t1 = std::min(t1, t);
+        }
+        if (t0 > t1) {
+            return false;
+        }
+    }
+    point_t start{a.first + t0 * dx, a.second + t0 * dy};
+    point_t end{a.first + t1 * dx, a.second + t1 * dy};
+    a = start;
+    b = end;
+    return true;
+}
+
+
+PointKdTree::PointKdTree(const std::vector<point_t> &points) : m_points(points) {
+    m_nodes.resize(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        m_nodes[i] = i;
+    }
+    build(0, m_nodes.size(), 0);
+}
+
+void PointKdTree::build(size_t begin, size_t end, int axis) {
+    if (end - begin <= 1) {
+        return;
+    }
+    size_t middle = begin + (end - begin) / 2;
+    std::nth_element(m_nodes.begin() + static_cast<long>(begin), m_nodes.begin() + static_cast<long>(middle),
+                     m_nodes.begin() + static_cast<long>(end), [&](size_t i, size_t j) {
+                return axis == 0 ? m_points[i].first < m_points[j].first : m_points[i].second < m_points[j].second;
+            });
+    build(begin, middle, 1 - axis);
+    build(middle + 1, end, 1 - axis);
+}
+
+size_t PointKdTree::nearest(point_t p) const {
+    size_t best = std::numeric_limits<size_t>::max();
+    double best_distance = HUGE_VAL;
+    nearest(p, 0, m_nodes.size(), 0, best, best_distance);
+    return best;
+}
+
+void PointKdTree::nearest(point_t p, size_t begin, size_t end, int axis, size_t &best, double &best_distance) const {
+    if (begin >= end) {
+        return;
+    }
+    size_t middle = begin + (end - begin) / 2;
+    size_t index = m_nodes[middle];
+    const auto &point = m_points[index];
+    double dx = point.first - p.first, dy = point.second - p.second;
+    double distance = dx * dx + dy * dy;
+    if (distance < best_distance || (distance == best_distance && index < best)) {
+        best_distance = distance;
+        best = index;
+    }
+
+    double axis_difference = axis == 0 ? p.first - point.first : p.second - point.second;
+    // Search the half with the query point first, the other one only if it can contain a closer point
+    if (axis_difference < 0) {
+        nearest(p, begin, middle, 1 - axis, best, best_distance);
+        if (axis_difference * axis_difference <= best_distance) {
+            nearest(p, middle + 1, end, 1 - axis, best, best_distance);
+        }
+    } else {
+        nearest(p, middle + 1, end, 1 - axis, best, best_distance);
+        if (axis_difference * axis_difference <= best_distance) {
+            nearest(p, begin, middle, 1 - axis, best, best_distance);
+        }
+    }
+}
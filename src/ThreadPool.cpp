@@ -0,0 +1,112 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace {
+    /*!
+     * Progress of one parallel_for() call. Shared with the helper tasks, as some of them may start only after the
+     * loop is finished
+     */
+    struct loop_state_t {
+        std::atomic<size_t> next_chunk{0};
+        size_t n_chunks = 0;
+        size_t chunk_size = 0;
+        size_t n = 0;
+
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t finished_chunks = 0;
+        std::exception_ptr exception;
+    };
+
+    void run_chunks(loop_state_t &state, const std::function<void(size_t, size_t)> &f) {
+        size_t chunk;
+        while ((chunk = state.next_chunk.fetch_add(1)) < state.n_chunks) {
+            size_t begin = chunk * state.chunk_size;
+            size_t end = std::min(state.n, begin + state.chunk_size);
+            std::exception_ptr exception;
+            try {
+                f(begin, end);
+            } catch (...) {
+                exception = std::current_exception();
+            }
+
+            std::scoped_lock lock(state.mutex);
+            if (exception && !state.exception) {
+                state.exception = exception;
+            }
+            if (++state.finished_chunks == state.n_chunks) {
+                state.finished.notify_all();
+            }
+        }
+    }
+}
+
+ThreadPool::ThreadPool(size_t n_threads) {
+    if (n_threads == 0) {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i + 1 < n_threads; ++i) {
+        m_workers.emplace_back([this] { worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    for (auto &worker: m_workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::worker_loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t, size_t)> &f, size_t min_chunk) {
+    if (n == 0) {
+        return;
+    }
+    auto state = std::make_shared<loop_state_t>();
+    state->n = n;
+    // Several chunks per thread to balance iterations of different cost
+    state->chunk_size = std::max(std::max<size_t>(min_chunk, 1), (n + 4 * size() - 1) / (4 * size()));
+    state->n_chunks = (n + state->chunk_size - 1) / state->chunk_size;
+
+    size_t n_helpers = std::min(m_workers.size(), state->n_chunks - 1);
+    if (n_helpers > 0) {
+        {
+            std::scoped_lock lock(m_mutex);
+            for (size_t i = 0; i < n_helpers; ++i) {
+                // f is only used while there are unprocessed chunks, i.e. before this function returns
+                m_tasks.emplace_back([state, &f] { run_chunks(*state, f); });
+            }
+        }
+        m_condition.notify_all();
+    }
+
+    run_chunks(*state, f);
+
+    std::unique_lock lock(state->mutex);
+    state->finished.wait(lock, [&] { return state->finished_chunks == state->n_chunks; });
+    if (state->exception) {
+        std::rethrow_exception(state->exception);
+    }
+}
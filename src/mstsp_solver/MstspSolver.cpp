@@ -4,6 +4,8 @@
 #include "algorithms.hpp"
 #include <algorithm>
 #include <list>
+#include <chrono>
+#include <map>
 
 vpdd remove_path_heading(const std::vector<point_heading_t<double>> &init) {
     vpdd res;
@@ -48,6 +50,53 @@ namespace mstsp_solver {
                                        m_energy_calculator,
                                        m_config.rotations_per_cell);
         }
+        compute_transition_energies();
+    }
+
+
+    void MstspSolver::compute_transition_energies() {
+        // Each distinct endpoint gets its own index, even if it coincides with the starting point, as the starting
+        // point can change on re-planning
+        std::map<point_t, size_t> endpoint_index;
+        for (const auto &target_set: m_target_sets) {
+            for (const auto &target: target_set.targets) {
+                endpoint_index.emplace(target.starting_point, 0);
+                endpoint_index.emplace(target.end_point, 0);
+            }
+        }
+        m_transition_points = {m_config.starting_point};
+        for (auto &[point, index]: endpoint_index) {
+            index = m_transition_points.size();
+            m_transition_points.push_back(point);
+        }
+        for (auto &target_set: m_target_sets) {
+            for (auto &target: target_set.targets) {
+                target.starting_point_transition = endpoint_index[target.starting_point];
+                target.end_point_transition = endpoint_index[target.end_point];
+            }
+        }
+        // The paths between these points are also queried when building the final trajectories
+        m_shortest_path_calculator.register_query_points(m_transition_points);
+
+        // The lengths of the shortest paths around no-fly zones for all the pairs at once
+        auto distances = m_shortest_path_calculator.distance_matrix(m_transition_points, m_transition_points);
+        m_transition_energies.resize(distances.size());
+        std::transform(distances.begin(), distances.end(), m_transition_energies.begin(),
+                       [&](double distance) { return get_straight_line_energy(distance); });
+    }
+
+
+    void MstspSolver::update_starting_point_transitions() {
+        m_transition_points[STARTING_POINT_TRANSITION] = m_config.starting_point;
+        // The same registration as in compute_transition_energies, so that the paths from and to the new starting
+        // point are found in the same way as after a full solve
+        m_shortest_path_calculator.register_query_points(m_transition_points);
+
+        const size_t n = m_transition_points.size();
+        auto distances = m_shortest_path_calculator.distances_from(m_config.starting_point, m_transition_points);
+        for (size_t i = 0; i < n; ++i) {
+            m_transition_energies[i] = m_transition_energies[i * n] = get_straight_line_energy(distances[i]);
+        }
     }
 
 
@@ -59,28 +108,22 @@ namespace mstsp_solver {
 
         for (size_t i = 0; i + 1 < path.size(); ++i) {
             energy += path[i].energy_consumption;
-            energy += m_energy_calculator.calculate_straight_line_energy(0,
-                                                                         m_energy_calculator.get_average_acceleration(),
-                                                                         0,
-                                                                         -m_energy_calculator.get_average_acceleration(),
-                                                                         path[i].end_point,
-                                                                         path[i + 1].starting_point);
-//            m_logger->log_warn("Energy between points: " + std::to_string(energy));
-            // TODO: think if really the shortest path calculation is needed. It works at least in O(N^2) but with caching.
-//            auto path_between_polygons = m_shortest_path_calculator.shortest_path_between_points(path[i].end_point, path[i + 1].starting_point);
-//            energy += m_energy_calculator.calculate_path_energy_consumption(path_between_polygons);
+            energy += get_transition_energy(path[i].end_point_transition, path[i + 1].starting_point_transition);
         }
         energy += path[path.size() - 1].energy_consumption;
-        auto a = m_energy_calculator.get_average_acceleration();
-        energy += m_energy_calculator.calculate_straight_line_energy(0, a, 0, -a, m_config.starting_point,
-                                                                     path[0].starting_point);
-        energy += m_energy_calculator.calculate_straight_line_energy(0, a, 0, -a, path[path.size() - 1].end_point,
-                                                                     m_config.starting_point);
+        energy += get_transition_energy(STARTING_POINT_TRANSITION, path[0].starting_point_transition);
+        energy += get_transition_energy(path[path.size() - 1].end_point_transition, STARTING_POINT_TRANSITION);
 
         return energy;
     }
 
 
+    double MstspSolver::get_straight_line_energy(double distance) const {
+        auto a = m_energy_calculator.get_average_acceleration();
+        return m_energy_calculator.calculate_straight_line_energy(0, a, 0, -a, distance).energy;
+    }
+
+
     double MstspSolver::get_path_cost(const std::vector<Target> &path) const {
         double energy = get_path_energy(path);
         return energy;
@@ -101,7 +144,7 @@ namespace mstsp_solver {
     }
 
 
-    _instance_solution_t MstspSolver::greedy_random() const {
+    _instance_solution_t MstspSolver::greedy_random(std::mt19937 &random_generator) const {
         _instance_solution_t current_solution(m_config.n_uavs);
         auto target_sets = m_target_sets;
 
@@ -137,7 +180,7 @@ namespace mstsp_solver {
             m_logger->log_debug("Possible insertions number " + std::to_string(possible_insertions.size()));
             size_t size_reduced = possible_insertions.size() / 4;
             // Could generate random numbers better, but let it be. We don't need a perfect uniformity
-            size_t random = generate_random_number() % (size_reduced + 1);
+            size_t random = random_number(random_generator) % (size_reduced + 1);
             if (random >= possible_insertions.size()) {
                 random = possible_insertions.size() - 1;
             }
@@ -154,6 +197,100 @@ namespace mstsp_solver {
     }
 
 
+    _instance_solution_t MstspSolver::regret_insertion(size_t k) const {
+        _instance_solution_t current_solution(m_config.n_uavs);
+
+        // Best insertions of each target set into each path: candidates[target_set][uav].
+        // Each list contains up to k cheapest insertion positions (with the best target for each position) sorted by cost.
+        // Insertion into one path does not change the insertion costs into other paths,
+        // so only the modified path is recalculated after each insertion
+        std::vector<std::vector<std::vector<Insertion>>> candidates(
+                m_target_sets.size(), std::vector<std::vector<Insertion>>(m_config.n_uavs));
+        std::vector<bool> inserted(m_target_sets.size(), false);
+        size_t remaining = 0;
+        for (size_t i = 0; i < m_target_sets.size(); ++i) {
+            // Target set with no targets cannot be inserted anyway
+            inserted[i] = m_target_sets[i].targets.empty();
+            remaining += !inserted[i];
+        }
+
+        auto update_path_candidates = [&](size_t uav) {
+            const auto &path = current_solution[uav];
+            double path_cost = get_path_cost(path);
+            for (size_t i = 0; i < m_target_sets.size(); ++i) {
+                if (inserted[i]) {
+                    continue;
+                }
+                auto &path_candidates = candidates[i][uav];
+                path_candidates.clear();
+                for (size_t position = 0; position <= path.size(); ++position) {
+                    // Only the transition between the neighbouring targets is replaced
+                    size_t previous = position == 0 ? STARTING_POINT_TRANSITION
+                                                    : path[position - 1].end_point_transition;
+                    size_t next = position == path.size() ? STARTING_POINT_TRANSITION
+                                                          : path[position].starting_point_transition;
+                    double base_cost = path.empty() ? 0 : path_cost - get_transition_energy(previous, next);
+
+                    Insertion best{std::numeric_limits<double>::max(), i, 0, uav, position};
+                    for (const auto &target: m_target_sets[i].targets) {
+                        double cost = base_cost + get_transition_energy(previous, target.starting_point_transition) +
+                                      target.energy_consumption +
+                                      get_transition_energy(target.end_point_transition, next);
+                        if (cost < best.solution_cost) {
+                            best.solution_cost = cost;
+                            best.target_index = target.target_index;
+                        }
+                    }
+                    path_candidates.insert(std::upper_bound(path_candidates.begin(), path_candidates.end(), best,
+                                                            InsertionComp{}), best);
+                    if (path_candidates.size() > k) {
+                        path_candidates.pop_back();
+                    }
+                }
+            }
+        };
+        for (size_t uav = 0; uav < m_config.n_uavs; ++uav) {
+            update_path_candidates(uav);
+        }
+
+        while (remaining > 0) {
+            // Select the target set that would lose the most if it is not inserted to its best position now
+            double best_regret = -1;
+            Insertion chosen_insertion{std::numeric_limits<double>::max(), 0, 0, 0, 0};
+            std::vector<Insertion> set_candidates;
+            for (size_t i = 0; i < m_target_sets.size(); ++i) {
+                if (inserted[i]) {
+                    continue;
+                }
+                set_candidates.clear();
+                for (const auto &path_candidates: candidates[i]) {
+                    set_candidates.insert(set_candidates.end(), path_candidates.begin(), path_candidates.end());
+                }
+                size_t n_best = std::min(k, set_candidates.size());
+                std::partial_sort(set_candidates.begin(), set_candidates.begin() + static_cast<long>(n_best),
+                                  set_candidates.end(), InsertionComp{});
+                double regret = 0;
+                for (size_t h = 1; h < n_best; ++h) {
+                    regret += set_candidates[h].solution_cost - set_candidates[0].solution_cost;
+                }
+                if (regret > best_regret ||
+                    (regret == best_regret && set_candidates[0].solution_cost < chosen_insertion.solution_cost)) {
+                    best_regret = regret;
+                    chosen_insertion = set_candidates[0];
+                }
+            }
+
+            auto &path = current_solution[chosen_insertion.uav_index];
+            path.insert(path.begin() + static_cast<long>(chosen_insertion.insertion_index),
+                        m_target_sets[chosen_insertion.target_set_index].targets[chosen_insertion.target_index]);
+            inserted[chosen_insertion.target_set_index] = true;
+            --remaining;
+            update_path_candidates(chosen_insertion.uav_index);
+        }
+        return current_solution;
+    }
+
+
     std::vector<std::vector<point_heading_t<double>>>
     MstspSolver::get_drones_paths(const _instance_solution_t &solution) const {
         std::vector<std::vector<point_heading_t<double>>> res;
@@ -212,59 +349,122 @@ namespace mstsp_solver {
 
     final_solution_t MstspSolver::solve() const {
         m_logger->log_info("Solving started");
-        _instance_solution_t init_solution = greedy_random();
+        solver_state_t state = initial_state();
+        return tabu_search(state, m_config.max_not_improving_iterations, {});
+    }
+
+
+    final_solution_t MstspSolver::solve(solver_state_t &state, const std::function<bool()> &stop_requested) const {
+        m_logger->log_info("Solving started from iteration " + std::to_string(state.iteration));
+        return tabu_search(state, m_config.max_not_improving_iterations, stop_requested);
+    }
+
+
+    solver_state_t MstspSolver::initial_state() const {
+        std::mt19937 random_generator{std::random_device{}()};
+        if (m_config.initial_solution_regret >= 2) {
+            return state_from_solution(regret_insertion(static_cast<size_t>(m_config.initial_solution_regret)),
+                                       random_generator);
+        }
+        auto solution = greedy_random(random_generator);
+        return state_from_solution(solution, random_generator);
+    }
+
+
+    final_solution_t MstspSolver::replan(point_t starting_point, double sweeping_alt, double unique_alt_step,
+                                         const _instance_solution_t &previous_solution,
+                                         int max_not_improving_iterations) {
+        if (previous_solution.size() != m_config.n_uavs) {
+            throw metaheuristic_application_error("Previous solution is for a different number of UAVs");
+        }
+        m_config.starting_point = starting_point;
+        m_config.sweeping_alt = sweeping_alt;
+        m_config.unique_alt_step = unique_alt_step;
+        update_starting_point_transitions();
+
+        m_logger->log_info("Re-planning started");
+        solver_state_t state = state_from_solution(previous_solution, std::mt19937{std::random_device{}()});
+        return tabu_search(state, max_not_improving_iterations, {});
+    }
+
+
+    solver_state_t MstspSolver::state_from_solution(const _instance_solution_t &init_solution,
+                                                    const std::mt19937 &random_generator) const {
+        solver_state_t state;
+        state.best_solution = init_solution;
+        state.best_solution_cost = get_solution_cost(init_solution);
+        state.current_solution = init_solution;
+        state.tabu_list.push_back(init_solution);
+        state.g1_score = state.g2_score = state.g3_score = state.g4_score = m_config.w0;
+        state.R_T_iterator = m_config.R_T;
+        state.random_generator = random_generator;
+        return state;
+    }
+
+
+    final_solution_t MstspSolver::tabu_search(solver_state_t &state, int max_not_improving_iterations,
+                                              const std::function<bool()> &stop_requested) const {
         size_t nodes = 0;
-        for (const auto &uav_path: init_solution) {
+        for (const auto &uav_path: state.current_solution) {
             nodes += uav_path.size();
         }
 
-        std::list<_instance_solution_t> tabu_list;
-        solution_cost_t best_solution_cost = get_solution_cost(init_solution);
+        // Continue the same sequence of random numbers as the one the state was saved with
+        auto &random_generator = state.random_generator;
+
+        auto &tabu_list = state.tabu_list;
+        auto &best_neighbourhood_solution = state.current_solution;
+        int &g1_score = state.g1_score, &g2_score = state.g2_score, &g3_score = state.g3_score, &g4_score = state.g4_score;
 
         int best_group = 0;
+        size_t best_operator = 0;
         solution_cost_t best_neighbourhood_cost = solution_cost_t::max();
 
-        _instance_solution_t best_neighbourhood_solution = init_solution;
-        tabu_list.push_back(init_solution);
-
-        int R_T_iterator = m_config.R_T;
-        bool stop_criteria = false;
-        int iteration = 0;
-        int no_improvement_iteration = 0;
-        int g1_score = m_config.w0;
-        int g2_score = g1_score, g3_score = g1_score, g4_score = g1_score;
-        _instance_solution_t final_solution = init_solution;
+        solver_stats_t stats;
+        auto search_start = std::chrono::steady_clock::now();
+        auto seconds_since = [](std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
 
-        while (!stop_criteria) {
-            if (iteration % 50 == 0) {
+        // The search is interrupted only between iterations, so the state can always be resumed
+        while (!(stop_requested && stop_requested())) {
+            if (state.iteration % 50 == 0) {
                 m_logger->log_debug("==================================================");
-                m_logger->log_debug("Iteration: " + std::to_string(iteration));
-                m_logger->log_debug("Iteration with no improvement: " + std::to_string(no_improvement_iteration));
-                m_logger->log_debug("Best solution cost: " + std::to_string(best_solution_cost.max_path_cost) + ", "
-                                    + std::to_string(best_solution_cost.path_cost_sum));
+                m_logger->log_debug("Iteration: " + std::to_string(state.iteration));
+                m_logger->log_debug("Iteration with no improvement: " + std::to_string(state.no_improvement_iteration));
+                m_logger->log_debug("Best solution cost: " + std::to_string(state.best_solution_cost.max_path_cost) + ", "
+                                    + std::to_string(state.best_solution_cost.path_cost_sum));
             }
-            ++iteration;
+            ++state.iteration;
             best_neighbourhood_cost = solution_cost_t::max();
 
             // Reset scores after R_T iterations
-            if (++R_T_iterator >= m_config.R_T) {
+            if (++state.R_T_iterator >= m_config.R_T) {
                 g1_score = g2_score = g3_score = g4_score = m_config.w0;
-                R_T_iterator = 0;
+                state.R_T_iterator = 0;
             }
 
             for (size_t j = 0; j < nodes; ++j) {
                 _instance_solution_t tabu_solution = best_neighbourhood_solution;
                 int total_score = g1_score + g2_score + g3_score + g4_score;
-                int random = generate_random_number() % total_score;
+                int random = random_number(random_generator) % total_score;
+                size_t applied_operator;
+                auto operator_start = std::chrono::steady_clock::now();
                 if (random < g1_score) {
-                    get_g1_solution(tabu_solution);
+                    get_g1_solution(tabu_solution, random_generator);
+                    applied_operator = 0;
                 } else if (random < (g1_score + g2_score)) {
-                    get_g2_solution(tabu_solution);
+                    get_g2_solution(tabu_solution, random_generator);
+                    applied_operator = 1;
                 } else if (random < (g1_score + g2_score + g3_score)) {
-                    get_g3_solution(tabu_solution);
+                    get_g3_solution(tabu_solution, random_generator);
+                    applied_operator = 2;
                 } else {
-                    get_g4_solution(tabu_solution);
+                    get_g4_solution(tabu_solution, random_generator);
+                    applied_operator = 3;
                 }
+                ++stats.operators[applied_operator].calls;
+                stats.operators[applied_operator].time += seconds_since(operator_start);
 
                 solution_cost_t tabu_solution_cost = get_solution_cost(tabu_solution);
                 if (tabu_solution_cost < best_neighbourhood_cost &&
@@ -272,15 +472,17 @@ namespace mstsp_solver {
                     best_neighbourhood_cost = tabu_solution_cost;
                     best_neighbourhood_solution = tabu_solution;
                     best_group = random;
+                    best_operator = applied_operator;
                 }
             }
-            ++no_improvement_iteration;
+            ++state.no_improvement_iteration;
 //            std::cout << "Best neighbourhood cost: " << best_neighbourhood_cost << std::endl;
             if (best_neighbourhood_cost < solution_cost_t::max()) {
                 if (tabu_list.size() >= nodes / 4) {
                     tabu_list.pop_front();
                 }
                 tabu_list.push_back(best_neighbourhood_solution);
+                ++stats.operators[best_operator].best_in_neighbourhood;
                 if (best_group < g1_score) {
                     g1_score += m_config.p1;
                 } else if (best_group < (g1_score + g2_score)) {
@@ -291,10 +493,11 @@ namespace mstsp_solver {
                     g4_score += m_config.p1;
                 }
 
-                if (best_neighbourhood_cost < best_solution_cost) {
-                    final_solution = best_neighbourhood_solution;
-                    best_solution_cost = best_neighbourhood_cost;
-                    no_improvement_iteration = 0;
+                if (best_neighbourhood_cost < state.best_solution_cost) {
+                    state.best_solution = best_neighbourhood_solution;
+                    state.best_solution_cost = best_neighbourhood_cost;
+                    state.no_improvement_iteration = 0;
+                    ++stats.operators[best_operator].improvements;
 
                     if (best_group < g1_score) {
                         g1_score += m_config.p2;
@@ -309,16 +512,45 @@ namespace mstsp_solver {
             }
             // TODO: check if the commented line ie needed
             //g1_score += m_config.p1;
-            if (no_improvement_iteration >= m_config.max_not_improving_iterations) {
-                stop_criteria = true;
+            ++stats.iterations;
+            stats.convergence.push_back({state.iteration, seconds_since(search_start),
+                                         state.best_solution_cost.max_path_cost,
+                                         state.best_solution_cost.path_cost_sum,
+                                         {g1_score, g2_score, g3_score, g4_score}});
+            if (state.no_improvement_iteration >= max_not_improving_iterations) {
+                break;
+            }
+        }
+        stats.time = seconds_since(search_start);
+
+        for (size_t i = 0; i < stats.operators.size(); ++i) {
+            const auto &op = stats.operators[i];
+            m_logger->log_debug("G" + std::to_string(i + 1) + ": calls: " + std::to_string(op.calls) +
+                                ", time: " + std::to_string(op.time) + " s, best in neighbourhood: " +
+                                std::to_string(op.best_in_neighbourhood) + ", improvements: " +
+                                std::to_string(op.improvements));
+        }
+        if (!m_config.convergence_trace_file.empty()) {
+            try {
+                save_convergence_trace(stats, m_config.convergence_trace_file);
+            } catch (const std::runtime_error &e) {
+                m_logger->log_warn(e.what());
             }
         }
-        return {best_solution_cost.max_path_cost, best_solution_cost.path_cost_sum, get_drones_paths(final_solution)};
+
+        return {state.best_solution_cost.max_path_cost, state.best_solution_cost.path_cost_sum,
+                get_drones_paths(state.best_solution), state.best_solution, std::move(stats)};
+    }
+
+
+    int MstspSolver::random_number(std::mt19937 &random_generator) {
+        std::uniform_int_distribution<int> distribution(0, std::numeric_limits<int>::max());
+        return distribution(random_generator);
     }
 
 
     // Random shift intra-inter route
-    void MstspSolver::get_g1_solution(_instance_solution_t &solution) const {
+    void MstspSolver::get_g1_solution(_instance_solution_t &solution, std::mt19937 &random_generator) const {
         for (size_t i = 0; i <= solution.size(); ++i) {
             // If each UAV visits only 1 or 0 polygons, there is no need (and it will lead to some errors) to continue
             if (i == solution.size()) {
@@ -332,25 +564,25 @@ namespace mstsp_solver {
         size_t routes = solution.size();
         size_t index_a1, index_a2;
         do {
-            index_a1 = generate_random_number() % routes;
+            index_a1 = random_number(random_generator) % routes;
         } while (solution[index_a1].size() < 2);
 
-        size_t index_c2, index_c1 = generate_random_number() % solution[index_a1].size();
+        size_t index_c2, index_c1 = random_number(random_generator) % solution[index_a1].size();
 
         Target target_to_move = solution[index_a1][index_c1];
         solution[index_a1].erase(solution[index_a1].begin() + static_cast<long>(index_c1));
 
-        if (generate_random_number() % 2 == 0 || solution.size() == 1) { // Shift intra route
+        if (random_number(random_generator) % 2 == 0 || solution.size() == 1) { // Shift intra route
             index_a2 = index_a1;
             do {
-                index_c2 = generate_random_number() % (solution[index_a1].size() + 1);
+                index_c2 = random_number(random_generator) % (solution[index_a1].size() + 1);
             } while (index_c1 == index_c2);
             solution[index_a2].emplace(solution[index_a2].begin() + static_cast<long>(index_c2), target_to_move);
         } else {
             do {
-                index_a2 = generate_random_number() % routes;
+                index_a2 = random_number(random_generator) % routes;
             } while (index_a2 == index_a1);
-            index_c2 = generate_random_number() % (solution[index_a2].size() + 1);
+            index_c2 = random_number(random_generator) % (solution[index_a2].size() + 1);
             solution[index_a2].emplace(solution[index_a2].begin() + static_cast<long>(index_c2), target_to_move);
         }
         // Try to rotate the moved target and find the best rotation
@@ -368,7 +600,7 @@ namespace mstsp_solver {
     }
 
     // best shift intra-inter route based on exhaustive search
-    void MstspSolver::get_g2_solution(_instance_solution_t &solution) const {
+    void MstspSolver::get_g2_solution(_instance_solution_t &solution, std::mt19937 &random_generator) const {
         for (size_t i = 0; i <= solution.size(); ++i) {
             // If each UAV visits only 1 or 0 polygons, there is no need (and it will lead to some errors) to continue
             if (i == solution.size()) {
@@ -382,10 +614,10 @@ namespace mstsp_solver {
         size_t routes = solution.size();
         size_t index_a1;
         do {
-            index_a1 = generate_random_number() % routes;
+            index_a1 = random_number(random_generator) % routes;
         } while (solution[index_a1].size() < 2);
 
-        size_t index_c1 = generate_random_number() % solution[index_a1].size();
+        size_t index_c1 = random_number(random_generator) % solution[index_a1].size();
 
         solution_cost_t best_solution_cost = solution_cost_t::max();
         size_t target_in_target_set_index = 0;
@@ -423,7 +655,7 @@ namespace mstsp_solver {
     }
 
     // best swap intra-inter route based on exhaustive search
-    void MstspSolver::get_g3_solution(_instance_solution_t &solution) const {
+    void MstspSolver::get_g3_solution(_instance_solution_t &solution, std::mt19937 &random_generator) const {
         for (size_t i = 0; i <= solution.size(); ++i) {
             // If each UAV visits only 1 or 0 polygons, there is no need (and it will lead to some errors) to continue
             if (i == solution.size()) {
@@ -437,10 +669,10 @@ namespace mstsp_solver {
         size_t routes = solution.size();
         size_t index_a1;
         do {
-            index_a1 = generate_random_number() % routes;
+            index_a1 = random_number(random_generator) % routes;
         } while (solution[index_a1].size() < 2);
 
-        size_t index_c1 = generate_random_number() % solution[index_a1].size();
+        size_t index_c1 = random_number(random_generator) % solution[index_a1].size();
         size_t index_a2 = index_a1, index_c2 = index_c1;
 
         auto best_solution_cost = solution_cost_t::max();
@@ -472,7 +704,7 @@ namespace mstsp_solver {
     }
 
 
-    void MstspSolver::get_g4_solution(_instance_solution_t &solution) const {
+    void MstspSolver::get_g4_solution(_instance_solution_t &solution, std::mt19937 &random_generator) const {
         for (size_t i = 0; i <= solution.size(); ++i) {
             // If each UAV visits only 1 or 0 polygons, there is no need (and it will lead to some errors) to continue
             if (i == solution.size()) {
@@ -486,10 +718,10 @@ namespace mstsp_solver {
         size_t routes = solution.size();
         size_t index_a1;
         do {
-            index_a1 = generate_random_number() % routes;
+            index_a1 = random_number(random_generator) % routes;
         } while (solution[index_a1].size() < 2);
 
-        size_t index_c1 = generate_random_number() % solution[index_a1].size();
+        size_t index_c1 = random_number(random_generator) % solution[index_a1].size();
 
         double best_path_cost = get_path_cost(solution[index_a1]);
         Target best_target = solution[index_a1][index_c1];
@@ -0,0 +1,182 @@
+#include "mstsp_solver/MstspSolver.h"
+#include <cstring>
+#include <sstream>
+#include <string>
+
+namespace {
+    // Checkpoint layout (native byte order):
+    // magic, version, problem fingerprint (n_uavs, number of target sets, number of targets in each of them),
+    // counters and operator scores, best solution cost, best solution, current solution, tabu list, generator state
+    const uint32_t CHECKPOINT_MAGIC = 0x4d535443; // "MSTC"
+    const uint32_t CHECKPOINT_VERSION = 2;
+
+    class CheckpointWriter {
+    public:
+        template<typename T>
+        void put(T value) {
+            auto pos = m_data.size();
+            m_data.resize(pos + sizeof(T));
+            std::memcpy(m_data.data() + pos, &value, sizeof(T));
+        }
+
+        void put_string(const std::string &value) {
+            put(static_cast<uint32_t>(value.size()));
+            m_data.insert(m_data.end(), value.begin(), value.end());
+        }
+
+        std::vector<uint8_t> &data() { return m_data; }
+
+    private:
+        std::vector<uint8_t> m_data;
+    };
+
+    class CheckpointReader {
+    public:
+        explicit CheckpointReader(const std::vector<uint8_t> &data) : m_data(data) {}
+
+        template<typename T>
+        T get() {
+            if (m_pos + sizeof(T) > m_data.size()) {
+                throw checkpoint_error("Checkpoint is truncated");
+            }
+            T value;
+            std::memcpy(&value, m_data.data() + m_pos, sizeof(T));
+            m_pos += sizeof(T);
+            return value;
+        }
+
+        std::string get_string() {
+            auto size = get<uint32_t>();
+            if (size > remaining()) {
+                throw checkpoint_error("Checkpoint is truncated");
+            }
+            std::string value(m_data.begin() + m_pos, m_data.begin() + m_pos + size);
+            m_pos += size;
+            return value;
+        }
+
+        [[nodiscard]] size_t remaining() const { return m_data.size() - m_pos; }
+
+        [[nodiscard]] bool at_end() const { return m_pos == m_data.size(); }
+
+    private:
+        const std::vector<uint8_t> &m_data;
+        size_t m_pos = 0;
+    };
+}
+
+namespace mstsp_solver {
+
+    std::vector<uint8_t> MstspSolver::save_checkpoint(const solver_state_t &state) const {
+        CheckpointWriter writer;
+        writer.put(CHECKPOINT_MAGIC);
+        writer.put(CHECKPOINT_VERSION);
+
+        writer.put(static_cast<uint32_t>(m_config.n_uavs));
+        writer.put(static_cast<uint32_t>(m_target_sets.size()));
+        for (const auto &target_set: m_target_sets) {
+            writer.put(static_cast<uint32_t>(target_set.targets.size()));
+        }
+
+        for (int value: {state.g1_score, state.g2_score, state.g3_score, state.g4_score, state.R_T_iterator,
+                         state.iteration, state.no_improvement_iteration}) {
+            writer.put(static_cast<int32_t>(value));
+        }
+        writer.put(state.best_solution_cost.max_path_cost);
+        writer.put(state.best_solution_cost.path_cost_sum);
+
+        // Each target is saved only as a pair of indices as all the other data can be taken from the target sets
+        auto put_solution = [&](const _instance_solution_t &solution) {
+            writer.put(static_cast<uint32_t>(solution.size()));
+            for (const auto &path: solution) {
+                writer.put(static_cast<uint32_t>(path.size()));
+                for (const auto &target: path) {
+                    writer.put(static_cast<uint32_t>(target.target_set_index));
+                    writer.put(static_cast<uint32_t>(target.target_index));
+                }
+            }
+        };
+        put_solution(state.best_solution);
+        put_solution(state.current_solution);
+        writer.put(static_cast<uint32_t>(state.tabu_list.size()));
+        for (const auto &solution: state.tabu_list) {
+            put_solution(solution);
+        }
+
+        // The standard library gives access to the generator state only through streams. Their text is saved as it
+        // is, as its format is up to the implementation
+        std::ostringstream generator_state;
+        generator_state << state.random_generator;
+        writer.put_string(generator_state.str());
+        return std::move(writer.data());
+    }
+
+    solver_state_t MstspSolver::load_checkpoint(const std::vector<uint8_t> &checkpoint) const {
+        CheckpointReader reader(checkpoint);
+        if (reader.get<uint32_t>() != CHECKPOINT_MAGIC) {
+            throw checkpoint_error("Not a solver checkpoint");
+        }
+        if (reader.get<uint32_t>() != CHECKPOINT_VERSION) {
+            throw checkpoint_error("Unsupported checkpoint version");
+        }
+
+        bool same_problem = reader.get<uint32_t>() == m_config.n_uavs &&
+                            reader.get<uint32_t>() == m_target_sets.size();
+        for (size_t i = 0; same_problem && i < m_target_sets.size(); ++i) {
+            same_problem = reader.get<uint32_t>() == m_target_sets[i].targets.size();
+        }
+        if (!same_problem) {
+            throw checkpoint_error("Checkpoint was saved for a different problem");
+        }
+
+        solver_state_t state;
+        for (int *value: {&state.g1_score, &state.g2_score, &state.g3_score, &state.g4_score, &state.R_T_iterator,
+                          &state.iteration, &state.no_improvement_iteration}) {
+            *value = reader.get<int32_t>();
+        }
+        state.best_solution_cost.max_path_cost = reader.get<double>();
+        state.best_solution_cost.path_cost_sum = reader.get<double>();
+
+        auto get_solution = [&]() {
+            // The counts are checked before allocating, so that a corrupted checkpoint cannot exhaust the memory
+            if (reader.get<uint32_t>() != m_config.n_uavs) {
+                throw checkpoint_error("Wrong number of paths in the checkpoint solution");
+            }
+            _instance_solution_t solution(m_config.n_uavs);
+            for (auto &path: solution) {
+                auto path_size = reader.get<uint32_t>();
+                if (path_size > reader.remaining() / (2 * sizeof(uint32_t))) {
+                    throw checkpoint_error("Checkpoint is truncated");
+                }
+                path.resize(path_size);
+                for (auto &target: path) {
+                    auto target_set_index = reader.get<uint32_t>();
+                    auto target_index = reader.get<uint32_t>();
+                    if (target_set_index >= m_target_sets.size() ||
+                        target_index >= m_target_sets[target_set_index].targets.size()) {
+                        throw checkpoint_error("Checkpoint refers to a non-existing target");
+                    }
+                    target = m_target_sets[target_set_index].targets[target_index];
+                }
+            }
+            return solution;
+        };
+        state.best_solution = get_solution();
+        state.current_solution = get_solution();
+        auto tabu_list_size = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < tabu_list_size; ++i) {
+            state.tabu_list.push_back(get_solution());
+        }
+
+        std::istringstream generator_state(reader.get_string());
+        generator_state >> state.random_generator;
+        if (generator_state.fail()) {
+            throw checkpoint_error("Checkpoint has an invalid generator state");
+        }
+
+        if (!reader.at_end()) {
+            throw checkpoint_error("Unexpected data at the end of the checkpoint");
+        }
+        return state;
+    }
+}
@@ -0,0 +1,24 @@
+#include "mstsp_solver/SolverStats.h"
+#include <fstream>
+#include <stdexcept>
+#include <iomanip>
+
+namespace mstsp_solver {
+
+    void save_convergence_trace(const solver_stats_t &stats, const std::string &filename) {
+        std::ofstream file(filename);
+        if (!file) {
+            throw std::runtime_error("Could not open " + filename + " for writing the convergence trace");
+        }
+        file << "iteration,time,best_max_path_cost,best_path_cost_sum,g1_score,g2_score,g3_score,g4_score\n";
+        file << std::setprecision(10);
+        for (const auto &record: stats.convergence) {
+            file << record.iteration << ',' << record.time << ',' << record.best_max_path_cost << ','
+                 << record.best_path_cost_sum;
+            for (int score: record.operator_scores) {
+                file << ',' << score;
+            }
+            file << '\n';
+        }
+    }
+}
@@ -7,12 +7,11 @@
 namespace mstsp_solver {
 
     TargetSet::TargetSet(size_t index, const MapPolygon &polygon, double sweeping_step, double wall_distance,
-                         EnergyCalculator energy_calculator,
+                         const EnergyCalculator &energy_calculator,
                          const std::vector<double> &rotation_angles) : index(index), polygon(polygon),
-                                                                       energy_calculator(std::move(energy_calculator)),
                                                                        sweeping_step(sweeping_step),
                                                                        m_wall_distance{wall_distance} {
-        set_rotation_angles(rotation_angles);
+        set_rotation_angles(rotation_angles, energy_calculator);
     }
 
 
@@ -20,16 +19,16 @@ namespace mstsp_solver {
                          const MapPolygon &polygon,
                          double sweeping_step,
                          double wall_distance,
-                         EnergyCalculator energy_calculator,
+                         const EnergyCalculator &energy_calculator,
                          size_t number_of_edges_rotations) : index(index), polygon(polygon),
-                                                             energy_calculator(std::move(energy_calculator)),
                                                              sweeping_step(sweeping_step),
                                                              m_wall_distance{wall_distance} {
 
         auto thin_coverage = thin_polygon_coverage(polygon, sweeping_step, 4);
         // If no thin coverage path is generated because the polygon is not thin enough, perform normal sweeping procedure
         if (thin_coverage.empty()) {
-            set_rotation_angles(polygon.get_n_longest_edges_rotation_angles(number_of_edges_rotations));
+            set_rotation_angles(polygon.get_n_longest_edges_rotation_angles(number_of_edges_rotations),
+                                energy_calculator);
         } else {
             targets.push_back(Target{
                     true, 0.0, 0.0, thin_coverage[0], thin_coverage.back(), index, targets.size()
@@ -39,7 +38,7 @@ namespace mstsp_solver {
 
     }
 
-    void TargetSet::add_one_rotation_angle(double angle, bool up) {
+    void TargetSet::add_one_rotation_angle(double angle, bool up, const EnergyCalculator &energy_calculator) {
         auto sweeping_path = sweeping(polygon, angle, sweeping_step, m_wall_distance, up);
         // If sweeping failed (e.g. because of the polygon splitting with such a rotation angle)
         if (sweeping_path.empty()) {
@@ -57,18 +56,18 @@ namespace mstsp_solver {
     }
 
 
-    void TargetSet::set_rotation_angles(const std::vector<double> &angles) {
+    void TargetSet::set_rotation_angles(const std::vector<double> &angles, const EnergyCalculator &energy_calculator) {
         targets.clear();
         for (auto angle: angles) {
             for (int i = 0; i < 2; i++) {
-                add_one_rotation_angle(angle, static_cast<bool>(i));
+                add_one_rotation_angle(angle, static_cast<bool>(i), energy_calculator);
             }
         }
         if (targets.empty()) {
             // If not sweeping angle produced a valid sweeping pattern
             // Try to add the sweeping with no angle. This should work for any polygon after boustrophedon decomposition
-            add_one_rotation_angle(0, true);
-            add_one_rotation_angle(0, false);
+            add_one_rotation_angle(0, true, energy_calculator);
+            add_one_rotation_angle(0, false, energy_calculator);
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,337 @@
+/*!
+ * Offline tuner of the MSTSP solver parameters.
+ *
+ * Runs the solver with randomly sampled SolverConfig parameters on the fields of the bundled worlds
+ * (safety area of custom_worlds/<world>/world_simulation.yaml) and on synthetic polygons, and reports the
+ * Pareto front of the solving time against the max path energy.
+ *
+ * Usage: solver_tuner <energy_model_config.yaml> <custom_worlds directory> [options]
+ *   --samples N          number of sampled configurations (default 30)
+ *   --repetitions N      solver runs per configuration and field (default 2)
+ *   --synthetic N        number of synthetic fields (default 3)
+ *   --uavs N             number of UAVs (default 3)
+ *   --sweeping-step S    distance between sweeping lines [m] (default 10)
+ *   --seed N             seed of the sampling and synthetic fields (default 0)
+ *   --output FILE        save all evaluated configurations to a CSV file
+ */
+
+#include "MapPolygon.hpp"
+#include "EnergyCalculator.h"
+#include "ShortestPathCalculator.hpp"
+#include "algorithms.hpp"
+#include "mstsp_solver/MstspSolver.h"
+#include <yaml-cpp/yaml.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+namespace {
+    struct field_t {
+        std::string name;
+        MapPolygon polygon;
+    };
+
+    struct tuned_parameters_t {
+        int p1;
+        int p2;
+        int R_T;
+        int w0;
+        int rotations_per_cell;
+        int max_not_improving_iterations;
+    };
+
+    struct evaluation_t {
+        tuned_parameters_t parameters;
+        double mean_time; // Mean solving time over all fields and repetitions [s]
+        double mean_energy_ratio; // Mean max path energy relative to the one of the default parameters
+        bool pareto_optimal = false;
+    };
+
+    struct tuner_options_t {
+        int samples = 30;
+        int repetitions = 2;
+        int synthetic = 3;
+        size_t n_uavs = 3;
+        double sweeping_step = 10;
+        unsigned int seed = 0;
+        std::string output;
+    };
+
+    energy_calculator_config_t load_energy_config(const std::string &filename) {
+        YAML::Node config = YAML::LoadFile(filename);
+        energy_calculator_config_t res{};
+        res.battery_model.cell_capacity = config["battery_model"]["cell_capacity"].as<double>();
+        res.battery_model.number_of_cells = config["battery_model"]["number_of_cells"].as<int>();
+        res.battery_model.d0 = config["battery_model"]["d0"].as<double>();
+        res.battery_model.d1 = config["battery_model"]["d1"].as<double>();
+        res.battery_model.d2 = config["battery_model"]["d2"].as<double>();
+        res.battery_model.d3 = config["battery_model"]["d3"].as<double>();
+        res.best_speed_model.c0 = config["best_speed_model"]["c0"].as<double>();
+        res.best_speed_model.c1 = config["best_speed_model"]["c1"].as<double>();
+        res.best_speed_model.c2 = config["best_speed_model"]["c2"].as<double>();
+        res.drone_mass = config["drone_mass"].as<double>();
+        res.drone_area = config["drone_area"].as<double>();
+        res.average_acceleration = config["average_acceleration"].as<double>();
+        res.propeller_radius = config["propeller_radius"].as<double>();
+        res.number_of_propellers = config["number_of_propellers"].as<int>();
+        res.allowed_path_deviation = config["allowed_path_deviation"].as<double>();
+        return res;
+    }
+
+    /*!
+     * Close the polygon and make it clockwise as it is done while creating a MapPolygon from a message
+     */
+    polygon_t closed_clockwise(polygon_t polygon) {
+        polygon.push_back(polygon.front());
+        make_polygon_clockwise(polygon);
+        return polygon;
+    }
+
+    /*!
+     * Load the field from the safety area of a world. Obstacles are added as no-fly zones if they are enabled
+     * @param filename world_simulation.yaml file of the world
+     */
+    MapPolygon load_world_field(const std::string &filename) {
+        YAML::Node safety_area = YAML::LoadFile(filename)["safety_area"];
+        auto coordinates = safety_area["safety_area"].as<std::vector<double>>();
+        if (coordinates.size() < 6 || coordinates.size() % 2 != 0) {
+            throw wrong_polygon_format_error("Wrong safety area in " + filename);
+        }
+        MapPolygon polygon;
+        for (size_t i = 0; i + 1 < coordinates.size(); i += 2) {
+            polygon.fly_zone_polygon_points.emplace_back(coordinates[i], coordinates[i + 1]);
+        }
+        polygon.fly_zone_polygon_points = closed_clockwise(polygon.fly_zone_polygon_points);
+
+        auto obstacles = safety_area["polygon_obstacles"];
+        if (obstacles && obstacles["enabled"].as<bool>()) {
+            // Matrices are stored row by row: x coordinates of all obstacles first, then y coordinates
+            auto data = obstacles["data"].as<std::vector<double>>();
+            auto cols = obstacles["cols"].as<std::vector<size_t>>();
+            size_t total_cols = data.size() / 2;
+            size_t first_col = 0;
+            for (auto n: cols) {
+                polygon_t no_fly_zone;
+                for (size_t i = first_col; i < first_col + n && i < total_cols; ++i) {
+                    no_fly_zone.emplace_back(data[i], data[total_cols + i]);
+                }
+                first_col += n;
+                polygon.no_fly_zone_polygons.push_back(closed_clockwise(no_fly_zone));
+            }
+        }
+        return polygon;
+    }
+
+    /*!
+     * Generate a random star-shaped field with a square no-fly zone in the middle
+     */
+    MapPolygon synthetic_field(std::mt19937 &generator) {
+        std::uniform_int_distribution<int> vertices_distribution(5, 10);
+        std::uniform_real_distribution<double> radius_distribution(150, 300);
+        int n = vertices_distribution(generator);
+        MapPolygon polygon;
+        for (int i = 0; i < n; ++i) {
+            double angle = 2 * M_PI * i / n;
+            double radius = radius_distribution(generator);
+            polygon.fly_zone_polygon_points.emplace_back(radius * std::cos(angle), radius * std::sin(angle));
+        }
+        polygon.fly_zone_polygon_points = closed_clockwise(polygon.fly_zone_polygon_points);
+        polygon.no_fly_zone_polygons.push_back(closed_clockwise({{-30, -30}, {-30, 30}, {30, 30}, {30, -30}}));
+        return polygon;
+    }
+
+    tuned_parameters_t sample_parameters(std::mt19937 &generator) {
+        auto uniform = [&](int from, int to) { return std::uniform_int_distribution<int>(from, to)(generator); };
+        return {uniform(0, 5), uniform(1, 20), uniform(5, 50), uniform(1, 20), uniform(1, 5), uniform(5, 60)};
+    }
+
+    /*!
+     * Solve the problem for the field
+     * @return pair of solving time [s] and max path energy [J]
+     */
+    std::pair<double, double> run_solver(const field_t &field, const tuned_parameters_t &parameters,
+                                         const tuner_options_t &options,
+                                         const EnergyCalculator &energy_calculator,
+                                         const std::shared_ptr<loggers::SimpleLogger> &logger) {
+        auto start = std::chrono::steady_clock::now();
+
+        ShortestPathCalculator shortest_path_calculator(field.polygon);
+        auto decomposed = trapezoidal_decomposition(field.polygon, BOUSTROPHEDON_DECOMPOSITION);
+        auto divided = split_into_number(decomposed, options.n_uavs * 2);
+
+        mstsp_solver::SolverConfig config{parameters.rotations_per_cell, options.sweeping_step,
+                                          field.polygon.fly_zone_polygon_points.front(), options.n_uavs, 10, 1,
+                                          parameters.max_not_improving_iterations};
+        config.p1 = parameters.p1;
+        config.p2 = parameters.p2;
+        config.R_T = parameters.R_T;
+        config.w0 = parameters.w0;
+
+        mstsp_solver::MstspSolver solver(config, divided, energy_calculator, shortest_path_calculator);
+        solver.set_logger(logger);
+        auto solution = solver.solve();
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return {time, solution.max_path_energy};
+    }
+
+    /*!
+     * Mark configurations that are not dominated in both solving time and energy ratio by another one
+     */
+    void mark_pareto_front(std::vector<evaluation_t> &evaluations) {
+        for (auto &e: evaluations) {
+            e.pareto_optimal = std::none_of(evaluations.begin(), evaluations.end(), [&](const evaluation_t &other) {
+                return other.mean_time <= e.mean_time && other.mean_energy_ratio <= e.mean_energy_ratio &&
+                       (other.mean_time < e.mean_time || other.mean_energy_ratio < e.mean_energy_ratio);
+            });
+        }
+    }
+
+    void print_usage(const char *program) {
+        std::cerr << "Usage: " << program << " <energy_model_config.yaml> <custom_worlds directory> [--samples N] "
+                  << "[--repetitions N] [--synthetic N] [--uavs N] [--sweeping-step S] [--seed N] [--output FILE]"
+                  << std::endl;
+    }
+
+    void print_evaluation(std::ostream &out, const evaluation_t &e, char separator) {
+        const auto &p = e.parameters;
+        out << p.p1 << separator << p.p2 << separator << p.R_T << separator << p.w0 << separator
+            << p.rotations_per_cell << separator << p.max_not_improving_iterations << separator
+            << e.mean_time << separator << e.mean_energy_ratio << separator << e.pareto_optimal << '\n';
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    tuner_options_t options;
+    for (int i = 3; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "Option " << option << " needs a value" << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[i + 1];
+        try {
+            if (option == "--samples") {
+                options.samples = std::stoi(value);
+            } else if (option == "--repetitions") {
+                options.repetitions = std::stoi(value);
+            } else if (option == "--synthetic") {
+                options.synthetic = std::stoi(value);
+            } else if (option == "--uavs") {
+                options.n_uavs = std::stoul(value);
+            } else if (option == "--sweeping-step") {
+                options.sweeping_step = std::stod(value);
+            } else if (option == "--seed") {
+                options.seed = std::stoul(value);
+            } else if (option == "--output") {
+                options.output = value;
+            } else {
+                std::cerr << "Unknown option " << option << std::endl;
+                print_usage(argv[0]);
+                return 1;
+            }
+        } catch (const std::logic_error &) {
+            // std::invalid_argument or std::out_of_range from the number conversions
+            std::cerr << "Invalid value " << value << " of option " << option << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    auto logger = std::make_shared<loggers::SimpleLogger>();
+    logger->set_log_level(loggers::LOG_NONE);
+    EnergyCalculator energy_calculator{load_energy_config(argv[1]), logger};
+
+    std::vector<field_t> fields;
+    for (const auto &entry: std::filesystem::directory_iterator(argv[2])) {
+        auto world_file = entry.path() / "world_simulation.yaml";
+        if (std::filesystem::exists(world_file)) {
+            fields.push_back({entry.path().filename().string(), load_world_field(world_file.string())});
+        }
+    }
+    std::mt19937 generator(options.seed);
+    for (int i = 0; i < options.synthetic; ++i) {
+        fields.push_back({"synthetic_" + std::to_string(i), synthetic_field(generator)});
+    }
+    std::sort(fields.begin(), fields.end(), [](const field_t &f1, const field_t &f2) { return f1.name < f2.name; });
+
+    // The first configuration is always the default one, so the energy is reported relative to it.
+    // rotations_per_cell and the no-improvement limit come from the request, so typical values are used for them
+    std::vector<tuned_parameters_t> candidates;
+    mstsp_solver::SolverConfig default_config{};
+    candidates.push_back({default_config.p1, default_config.p2, default_config.R_T, default_config.w0, 3, 20});
+    for (int i = 0; i < options.samples; ++i) {
+        candidates.push_back(sample_parameters(generator));
+    }
+
+    std::vector<double> baseline_energy(fields.size(), 0);
+    std::vector<evaluation_t> evaluations;
+    for (size_t c = 0; c < candidates.size(); ++c) {
+        double total_time = 0, total_energy_ratio = 0;
+        int runs = 0, compared_fields = 0;
+        for (size_t f = 0; f < fields.size(); ++f) {
+            double field_energy = 0;
+            int field_runs = 0;
+            for (int r = 0; r < options.repetitions; ++r) {
+                try {
+                    auto [time, energy] = run_solver(fields[f], candidates[c], options, energy_calculator, logger);
+                    total_time += time;
+                    field_energy += energy;
+                    ++field_runs;
+                } catch (const std::runtime_error &e) {
+                    std::cerr << "Field " << fields[f].name << " failed: " << e.what() << std::endl;
+                }
+            }
+            if (field_runs == 0) {
+                continue;
+            }
+            runs += field_runs;
+            field_energy /= field_runs;
+            if (c == 0) {
+                baseline_energy[f] = field_energy;
+            }
+            if (baseline_energy[f] > 0) {
+                total_energy_ratio += field_energy / baseline_energy[f];
+                ++compared_fields;
+            }
+        }
+        if (runs == 0 || compared_fields == 0) {
+            continue;
+        }
+        evaluations.push_back({candidates[c], total_time / runs, total_energy_ratio / compared_fields});
+        std::cerr << "Evaluated configuration " << c + 1 << "/" << candidates.size() << std::endl;
+    }
+    mark_pareto_front(evaluations);
+
+    std::sort(evaluations.begin(), evaluations.end(),
+              [](const evaluation_t &e1, const evaluation_t &e2) { return e1.mean_time < e2.mean_time; });
+    std::cout << "Fields:";
+    for (const auto &field: fields) {
+        std::cout << " " << field.name;
+    }
+    std::cout << "\nPareto front (energy relative to the default parameters):\n";
+    std::cout << "p1 p2 R_T w0 rotations_per_cell max_not_improving_iterations time[s] energy_ratio pareto\n";
+    std::cout << std::setprecision(5);
+    for (const auto &e: evaluations) {
+        if (e.pareto_optimal) {
+            print_evaluation(std::cout, e, ' ');
+        }
+    }
+
+    if (!options.output.empty()) {
+        std::ofstream file(options.output);
+        file << "p1,p2,R_T,w0,rotations_per_cell,max_not_improving_iterations,time,energy_ratio,pareto\n";
+        for (const auto &e: evaluations) {
+            print_evaluation(file, e, ',');
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+#include "EnergyCalculator.h"
+#include "test_utils.h"
+
+namespace {
+    using properties_array_t = std::array<double, 6>;
+
+    properties_array_t to_array(const turning_properties_t &p) {
+        return {p.v_before, p.a_before, p.v_after, p.a_after, p.energy, p.d_vym};
+    }
+
+    const char *const PROPERTY_NAMES[] = {"v_before", "a_before", "v_after", "a_after", "energy", "d_vym"};
+
+    // The properties of tiny turns are close to 0, so the error is relative to the largest value over all the angles
+    const double MAX_RELATIVE_ERROR = 1e-3;
+
+    const double TABLE_STEP = EnergyCalculator::TURNING_TABLE_MAX_ANGLE / (EnergyCalculator::TURNING_TABLE_SIZE - 1);
+}
+
+TEST(TurningTable, InterpolationMatchesExactFormula) {
+    EnergyCalculator energy_calculator{test_energy_config()};
+    const size_t n_samples = 100000;
+    std::vector<double> angles;
+    for (size_t i = 0; i <= n_samples; ++i) {
+        angles.push_back(EnergyCalculator::TURNING_TABLE_MAX_ANGLE * static_cast<double>(i) / n_samples);
+    }
+
+    properties_array_t scale{};
+    for (double angle: angles) {
+        auto exact = to_array(energy_calculator.calculate_turning_properties(angle));
+        for (size_t j = 0; j < scale.size(); ++j) {
+            scale[j] = std::max(scale[j], std::abs(exact[j]));
+        }
+    }
+
+    properties_array_t max_error{};
+    for (double angle: angles) {
+        auto exact = to_array(energy_calculator.calculate_turning_properties(angle));
+        auto table = to_array(energy_calculator.get_turning_properties(angle));
+        for (size_t j = 0; j < max_error.size(); ++j) {
+            max_error[j] = std::max(max_error[j], std::abs(table[j] - exact[j]) / scale[j]);
+        }
+    }
+    for (size_t j = 0; j < max_error.size(); ++j) {
+        EXPECT_LT(max_error[j], MAX_RELATIVE_ERROR) << PROPERTY_NAMES[j];
+    }
+}
+
+TEST(TurningTable, FallsBackToExactFormulaOutOfTableRange) {
+    EnergyCalculator energy_calculator{test_energy_config()};
+    // Below the first table step the exact formula is discontinuous, above the table it is a straight line
+    for (double angle: {0.0, TABLE_STEP / 2, std::nextafter(TABLE_STEP, 0.0),
+                        std::nextafter(EnergyCalculator::TURNING_TABLE_MAX_ANGLE, M_PI), M_PI - M_PI / 360, M_PI}) {
+        auto exact = to_array(energy_calculator.calculate_turning_properties(angle));
+        auto table = to_array(energy_calculator.get_turning_properties(angle));
+        for (size_t j = 0; j < exact.size(); ++j) {
+            EXPECT_EQ(table[j], exact[j]) << PROPERTY_NAMES[j] << " at angle " << angle;
+        }
+    }
+}
+
+TEST(TurningTable, MatchesExactFormulaAtTableBoundaries) {
+    EnergyCalculator energy_calculator{test_energy_config()};
+    for (double angle: {TABLE_STEP, EnergyCalculator::TURNING_TABLE_MAX_ANGLE}) {
+        auto exact = to_array(energy_calculator.calculate_turning_properties(angle));
+        auto table = to_array(energy_calculator.get_turning_properties(angle));
+        for (size_t j = 0; j < exact.size(); ++j) {
+            EXPECT_NEAR(table[j], exact[j], 1e-9 * std::max(1.0, std::abs(exact[j])))
+                                << PROPERTY_NAMES[j] << " at angle " << angle;
+        }
+    }
+}
+
+TEST(TurningTable, IsSymmetricInAngle) {
+    EnergyCalculator energy_calculator{test_energy_config()};
+    for (double angle: {TABLE_STEP / 2, 0.5, 1.5, 3.0, M_PI}) {
+        auto positive = to_array(energy_calculator.get_turning_properties(angle));
+        auto negative = to_array(energy_calculator.get_turning_properties(-angle));
+        for (size_t j = 0; j < positive.size(); ++j) {
+            EXPECT_EQ(positive[j], negative[j]) << PROPERTY_NAMES[j] << " at angle " << angle;
+        }
+    }
+}
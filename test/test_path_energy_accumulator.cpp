@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include "PathEnergyAccumulator.h"
+#include "test_utils.h"
+
+namespace {
+    /*!
+     * Push and pop random points, sometimes repeating the last one, and compare the accumulated energy with the
+     * energy of the whole path after each step
+     */
+    void check_random_pushes_and_pops(const EnergyCalculator &energy_calculator) {
+        PathEnergyAccumulator accumulator{energy_calculator};
+        std::vector<point_t> path;
+        std::mt19937 random_generator{42};
+        std::uniform_real_distribution<double> coordinate(0, 300);
+        std::uniform_int_distribution<int> action(0, 9);
+        for (int step = 0; step < 5000; ++step) {
+            int a = action(random_generator);
+            if (a < 3 && !path.empty()) {
+                accumulator.pop_back();
+                path.pop_back();
+            } else {
+                point_t p = a == 3 && !path.empty() ? path.back()
+                                                    : point_t{coordinate(random_generator), coordinate(random_generator)};
+                accumulator.push_back(p);
+                path.push_back(p);
+            }
+            ASSERT_EQ(accumulator.size(), path.size());
+            auto expected = energy_calculator.calculate_path_energy_and_time(path);
+            auto result = accumulator.energy_and_time();
+            ASSERT_NEAR(result.energy, expected.energy, 1e-9 * std::max(1.0, expected.energy)) << "step " << step;
+            ASSERT_NEAR(result.time, expected.time, 1e-9 * std::max(1.0, expected.time)) << "step " << step;
+        }
+    }
+}
+
+TEST(PathEnergyAccumulator, MatchesWholePathEnergy) {
+    check_random_pushes_and_pops(EnergyCalculator{test_energy_config()});
+}
+
+TEST(PathEnergyAccumulator, MatchesWholePathEnergyWithSegmentCache) {
+    EnergyCalculator energy_calculator{test_energy_config()};
+    energy_calculator.enable_segment_cache(1024);
+    check_random_pushes_and_pops(energy_calculator);
+}
+
+TEST(PathEnergyAccumulator, EmptyAndSinglePointPathsHaveNoEnergy) {
+    PathEnergyAccumulator accumulator{EnergyCalculator{test_energy_config()}};
+    EXPECT_EQ(accumulator.energy(), 0);
+    accumulator.pop_back();
+    EXPECT_TRUE(accumulator.empty());
+    accumulator.push_back({1, 2});
+    accumulator.push_back({1, 2});
+    EXPECT_EQ(accumulator.energy(), 0);
+    EXPECT_EQ(accumulator.time(), 0);
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "PathEnergyIndex.h"
+#include "test_utils.h"
+
+namespace {
+    /*!
+     * Random path with some repeated consecutive points
+     */
+    std::vector<point_t> random_path(size_t n_points) {
+        std::mt19937 random_generator{7};
+        std::uniform_real_distribution<double> coordinate(0, 300);
+        std::vector<point_t> path;
+        while (path.size() < n_points) {
+            if (!path.empty() && random_generator() % 5 == 0) {
+                path.push_back(path.back());
+            } else {
+                path.emplace_back(coordinate(random_generator), coordinate(random_generator));
+            }
+        }
+        return path;
+    }
+
+    /*!
+     * Compare each range of the index with the energy of the same sub-path flown on its own, i.e. starting from
+     * hovering at its first point and stopping at its last one
+     */
+    void check_all_ranges(const EnergyCalculator &energy_calculator) {
+        auto path = random_path(60);
+        PathEnergyIndex index{energy_calculator, path};
+        ASSERT_EQ(index.size(), path.size());
+        for (size_t i = 0; i < path.size(); ++i) {
+            for (size_t j = i; j < path.size(); ++j) {
+                std::vector<point_t> sub_path(path.begin() + i, path.begin() + j + 1);
+                auto expected = energy_calculator.calculate_path_energy_and_time(sub_path);
+                auto result = index.range(i, j);
+                ASSERT_NEAR(result.energy, expected.energy, 1e-9 * std::max(1.0, expected.energy)) << i << ", " << j;
+                ASSERT_NEAR(result.time, expected.time, 1e-9 * std::max(1.0, expected.time)) << i << ", " << j;
+            }
+        }
+    }
+}
+
+TEST(PathEnergyIndex, RangeMatchesSubPathEnergy) {
+    check_all_ranges(EnergyCalculator{test_energy_config()});
+}
+
+TEST(PathEnergyIndex, RangeMatchesSubPathEnergyWithSegmentCache) {
+    EnergyCalculator energy_calculator{test_energy_config()};
+    energy_calculator.enable_segment_cache(1024);
+    check_all_ranges(energy_calculator);
+}
+
+TEST(PathEnergyIndex, FindEnergyLimitMatchesLinearSearch) {
+    EnergyCalculator energy_calculator{test_energy_config()};
+    auto path = random_path(200);
+    PathEnergyIndex index{energy_calculator, path};
+    for (size_t from = 0; from < path.size(); from += 7) {
+        for (double energy_limit: {0.0, 1000.0, 5000.0, 20000.0, 1e9}) {
+            size_t expected = from + 1;
+            while (expected < path.size() && index.range(from, expected).energy <= energy_limit) {
+                ++expected;
+            }
+            EXPECT_EQ(index.find_energy_limit(from, energy_limit), expected) << from << ", " << energy_limit;
+        }
+    }
+}
+
+TEST(PathEnergyIndex, RejectsInvalidRanges) {
+    EnergyCalculator energy_calculator{test_energy_config()};
+    PathEnergyIndex index{energy_calculator, random_path(10)};
+    EXPECT_THROW(static_cast<void>(index.range(5, 4)), std::out_of_range);
+    EXPECT_THROW(static_cast<void>(index.range(0, 10)), std::out_of_range);
+    EXPECT_THROW(static_cast<void>(index.find_energy_limit(10, 1000)), std::out_of_range);
+}
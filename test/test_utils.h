@@ -0,0 +1,22 @@
+#ifndef THESIS_TRAJECTORY_GENERATOR_TEST_UTILS_H
+#define THESIS_TRAJECTORY_GENERATOR_TEST_UTILS_H
+
+#include "EnergyCalculator.h"
+
+/*!
+ * Parameters of custom_configs/energy_model_config.yaml
+ */
+inline energy_calculator_config_t test_energy_config() {
+    energy_calculator_config_t config{};
+    config.battery_model = {5, 4, 0.99876, -0.0020, -5.2484e-05, 1.2230e-07};
+    config.best_speed_model = {0.041546, 0.041122, 0.00053292};
+    config.drone_mass = 0.9;
+    config.drone_area = 0.0215;
+    config.average_acceleration = 10;
+    config.propeller_radius = 0.119;
+    config.number_of_propellers = 4;
+    config.allowed_path_deviation = 0.5;
+    return config;
+}
+
+#endif //THESIS_TRAJECTORY_GENERATOR_TEST_UTILS_H